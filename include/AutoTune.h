@@ -0,0 +1,365 @@
+#pragma once
+
+
+
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <fstream>
+#include <sstream>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <limits>
+
+#include "ThreadPool.h"
+
+
+
+namespace InnerProducts
+{
+
+
+	// Passed as the chunk size to a _Par inner product,
+	// it takes the chunk size and the thread count from the AutoTuner
+	constexpr size_t kAutoTune { 0 };
+
+
+	// The cache sizes (in bytes) and the number of cores of the machine
+	struct CpuTopology
+	{
+		size_t	fL1 { 32 * 1024 };
+		size_t	fL2 { 1024 * 1024 };
+		size_t	fLLC { 8 * 1024 * 1024 };
+		size_t	fCores { std::max( 1u, std::thread::hardware_concurrency() ) };
+	};
+
+
+	///////////////////////////////////////////////////////////
+	// Reads the caches and cores of the CPU
+	///////////////////////////////////////////////////////////
+	//
+	// REMARKS:
+	//		The data and unified caches of cpu0 are read from
+	//		/sys/devices/system/cpu; the number of cores from
+	//		/sys/devices/system/cpu/online. Where sysfs is not
+	//		there (not Linux), the defaults of CpuTopology stay.
+	//
+	inline CpuTopology GetCpuTopology( void )
+	{
+		CpuTopology		topo;
+
+		const std::string	kCpu { "/sys/devices/system/cpu/" };
+
+		for( int idx = 0; ; ++ idx )
+		{
+			const std::string kDir { kCpu + "cpu0/cache/index" + std::to_string( idx ) + "/" };
+
+			std::ifstream	level_file( kDir + "level" ), type_file( kDir + "type" ), size_file( kDir + "size" );
+			if( ! level_file || ! type_file || ! size_file )
+				break;
+
+			int				level {};
+			std::string		type;
+			size_t			size {};
+			char			unit {};
+			level_file >> level;
+			type_file >> type;
+			size_file >> size >> unit;
+
+			if( type == "Instruction" || size == 0 )
+				continue;
+
+			size *= unit == 'K' ? 1024 : unit == 'M' ? 1024 * 1024 : 1;
+
+			if( level == 1 )
+				topo.fL1 = size;
+			else if( level == 2 )
+				topo.fL2 = size;
+			else
+				topo.fLLC = size;		// the last level
+		}
+
+		// e.g. "0-7" or "0-3,8-11"
+		std::ifstream	online( kCpu + "online" );
+		size_t			cores {};
+		for( std::string range; std::getline( online, range, ',' ); )
+		{
+			std::istringstream	iss( range );
+			size_t				from {}, to {};
+			char				dash {};
+			if( iss >> from )
+				cores += ( iss >> dash >> to ) ? to - from + 1 : 1;
+		}
+		if( cores > 0 )
+			topo.fCores = cores;
+
+		return topo;
+	}
+
+
+
+	// The best parameters of a _Par kernel
+	struct TunedParams
+	{
+		size_t	fChunkSize {};
+		size_t	fThreads {};		// the workers of the pool to use
+	};
+
+
+	// Finds, and remembers, the fastest chunk size and thread count
+	// of each _Par kernel for each kind of the data (see SetDataTag),
+	// each size class of the data (i.e. floor( log2( n ) )) and each
+	// size of the thread pool. The results are kept in a profile file,
+	// so the calibration is done once per machine.
+	class AutoTuner
+	{
+		private:
+
+			using Key = std::tuple< std::string, std::string, int, size_t >;		// kernel, data tag, size class, pool size
+
+			std::map< Key, TunedParams >	fProfile;
+
+			std::string		fFileName { "ip_tuning.txt" };
+
+			std::string		fDataTag { "-" };
+
+			bool			fUnsaved {};		// new entries since the last SaveProfile()
+
+			TunedParams		fLastUsed;			// of the last run of RunTuned
+
+			CpuTopology		fTopo { GetCpuTopology() };
+
+			std::mutex		fMutex;
+
+			static constexpr const char *	kFileHeader { "# v2 size_class pool_size chunk_size threads data kernel" };
+
+			AutoTuner( void ) { Load(); }
+
+			~AutoTuner( void ) { SaveProfile(); }
+
+			static int SizeClass( size_t n )
+			{
+				int c {};
+				while( n >>= 1 )
+					++ c;
+				return c;
+			}
+
+			void Load( void )
+			{
+				fProfile.clear();
+
+				std::ifstream	file( fFileName );
+
+				// A profile of the older format (with no data tags) is not read, so it is tuned again
+				std::string		header;
+				if( ! std::getline( file, header ) || header != kFileHeader )
+					return;
+
+				for( std::string line; std::getline( file, line ); )
+				{
+					if( line.empty() || line[ 0 ] == '#' )
+						continue;
+
+					// The kernel names have spaces, so it goes last
+					std::istringstream	iss( line );
+					int					size_class {};
+					size_t				pool_size {};
+					TunedParams			p;
+					std::string			tag, name;
+					if( iss >> size_class >> pool_size >> p.fChunkSize >> p.fThreads >> tag && std::getline( iss >> std::ws, name ) && p.fChunkSize > 0 )
+						fProfile[ { name, tag, size_class, pool_size } ] = p;
+				}
+			}
+
+			void Save( void ) const
+			{
+				std::ofstream	file( fFileName, std::ios::trunc );
+				file << kFileHeader << '\n';
+				for( const auto & [ key, p ] : fProfile )
+					file << std::get< 2 >( key ) << ' ' << std::get< 3 >( key ) << ' ' << p.fChunkSize << ' ' << p.fThreads << ' '
+						 << std::get< 1 >( key ) << ' ' << std::get< 0 >( key ) << '\n';
+			}
+
+			// Chunks of both vectors that fit in L1, half of L2, L2,
+			// the share of LLC of a core, and a few chunks per core
+			std::vector< size_t > ChunkCandidates( const size_t n, const size_t kPoolSize ) const
+			{
+				const size_t kBytesPerElem { 2 * sizeof( double ) };
+
+				std::vector< size_t >	c { fTopo.fL1 / kBytesPerElem, fTopo.fL2 / ( 2 * kBytesPerElem ), fTopo.fL2 / kBytesPerElem,
+											fTopo.fLLC / ( kBytesPerElem * fTopo.fCores ), n / ( 4 * kPoolSize ) };
+
+				for( auto & x : c )
+					x = std::clamp( x / 64 * 64, std::clamp( n, size_t( 1 ), size_t( 1024 ) ), std::max( n, size_t( 1 ) ) );		// whole cache lines
+
+				std::sort( c.begin(), c.end() );
+				c.erase( std::unique( c.begin(), c.end() ), c.end() );
+				return c;
+			}
+
+			// All of the workers, then ..., 4, 2, 1 - the most likely first,
+			// in case the calibration runs out of time
+			static std::vector< size_t > ThreadCandidates( const size_t kPoolSize )
+			{
+				std::vector< size_t >	t { kPoolSize };
+				for( size_t k = size_t( 1 ) << 30; k > 0; k /= 2 )
+					if( k < kPoolSize )
+						t.push_back( k );
+				return t;
+			}
+
+		public:
+
+			static AutoTuner & Instance( void )
+			{
+				static AutoTuner	theTuner;
+				return theTuner;
+			}
+
+			const CpuTopology & Topology( void ) const { return fTopo; }
+
+			// Switches to another profile file (and reads it);
+			// the new entries of the current one are saved first
+			void SetProfileFile( const std::string & file_name )
+			{
+				std::lock_guard< std::mutex >	lock( fMutex );
+				if( fUnsaved )
+					Save();
+				fUnsaved = false;
+				fFileName = file_name;
+				Load();
+			}
+
+			// Writes the profile file, if anything was tuned since it was read.
+			// It is called once after the tuning pass (and at the exit).
+			void SaveProfile( void )
+			{
+				std::lock_guard< std::mutex >	lock( fMutex );
+				if( fUnsaved )
+					Save();
+				fUnsaved = false;
+			}
+
+			// The chunk size and thread count the last call of RunTuned
+			// ran with (of any kernel), e.g. to put them in the report
+			TunedParams LastUsed( void )
+			{
+				std::lock_guard< std::mutex >	lock( fMutex );
+				return fLastUsed;
+			}
+
+			void SetLastUsed( const TunedParams & p )
+			{
+				std::lock_guard< std::mutex >	lock( fMutex );
+				fLastUsed = p;
+			}
+
+			// The kind of the data of the next calls of Get() (e.g. the data
+			// set type), since the cost of some kernels depends on the values,
+			// not only on n. Empty means any data.
+			void SetDataTag( const std::string & tag )
+			{
+				std::lock_guard< std::mutex >	lock( fMutex );
+				fDataTag = tag.empty() ? "-" : tag;
+			}
+
+			///////////////////////////////////////////////////////////
+			// Returns the tuned parameters of a kernel
+			///////////////////////////////////////////////////////////
+			//
+			// INPUT:
+			//		name - identifies the kernel in the profile
+			//		n - number of elements
+			//		run - run( chunk_size, threads ) computes the inner
+			//			product with the given parameters
+			// OUTPUT:
+			//		the best chunk size and thread count
+			//
+			// REMARKS:
+			//		If the kernel was not tuned for this data tag and size
+			//		class yet, then each pair of the candidates is run (the
+			//		best of kReps runs) on the actual data, and the fastest
+			//		one goes to the profile. The calibration stops trying
+			//		the new pairs after kBudget. The lock is not held while
+			//		the candidates run, and the file is not written here
+			//		(see SaveProfile), so the calibration is better done
+			//		in a tuning pass before the timed runs.
+			//
+			template < typename F >
+			TunedParams Get( const std::string & name, const size_t n, F run )
+			{
+				using timer = std::chrono::steady_clock;
+
+				constexpr int		kReps { 3 };
+				const auto			kBudget = std::chrono::duration< double >( 1.0 );
+
+				const size_t kPoolSize = GetThreadPool().size();
+
+				Key		key;
+				{
+					std::lock_guard< std::mutex >	lock( fMutex );
+
+					key = { name, fDataTag, SizeClass( n ), kPoolSize };
+
+					if( auto it = fProfile.find( key ); it != fProfile.end() )
+						return it->second;
+				}
+
+				TunedParams		best { std::max( n, size_t( 1 ) ), kPoolSize };
+				double			best_time { std::numeric_limits< double >::max() };
+
+				const auto kStart = timer::now();
+
+				for( const auto t : ThreadCandidates( kPoolSize ) )
+					for( const auto c : ChunkCandidates( n, kPoolSize ) )
+					{
+						if( timer::now() - kStart > kBudget && best_time < std::numeric_limits< double >::max() )
+							break;
+
+						double min_time { std::numeric_limits< double >::max() };
+						for( int r = 0; r < kReps; ++ r )
+						{
+							const auto ts = timer::now();
+							[[ maybe_unused ]] const auto res = run( c, t );
+							min_time = std::min( min_time, std::chrono::duration< double >( timer::now() - ts ).count() );
+						}
+
+						if( min_time < best_time )
+						{
+							best_time = min_time;
+							best = { c, t };
+						}
+					}
+
+				// If another thread tuned the same meanwhile, then its result stays
+				std::lock_guard< std::mutex >	lock( fMutex );
+				const auto [ it, inserted ] = fProfile.try_emplace( key, best );
+				fUnsaved = fUnsaved || inserted;
+
+				return it->second;
+			}
+	};
+
+
+	// Runs run( chunk_size, threads ) of a _Par kernel - with the given
+	// chunk size on all of the workers, or with the tuned parameters
+	// if kChunkSize is kAutoTune. The parameters it ran with are then
+	// returned by AutoTuner::LastUsed.
+	template < typename F >
+	auto RunTuned( const std::string & name, const size_t n, const size_t kChunkSize, F run )
+	{
+		const TunedParams p = kChunkSize != kAutoTune ? TunedParams { kChunkSize, GetThreadPool().size() } : AutoTuner::Instance().Get( name, n, run );
+
+		const auto res = run( p.fChunkSize, p.fThreads );
+
+		// After the run, since a kernel can call the other tuned ones
+		AutoTuner::Instance().SetLastUsed( p );
+		return res;
+	}
+
+
+}	// end of namespace
@@ -0,0 +1,245 @@
+#pragma once
+
+
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+#include <cmath>
+#include <type_traits>
+
+#include "DataView.h"
+#include "ErrorBound.h"
+
+
+
+namespace InnerProducts
+{
+
+
+	// How a kernel is measured
+	struct BenchmarkSettings
+	{
+		size_t	fWarmUps { 1 };				// untimed runs before the measurements
+		size_t	fRepetitions { 5 };			// timed runs (at most)
+		double	fTimeBudget_s { 2.0 };		// no more repetitions once this is spent (at least one is always done)
+		bool	fErrorBound { true };		// the kernels also return their error bound (in the timed runs)
+	};
+
+
+	// Timing statistics of the repetitions of a kernel
+	struct BenchmarkStats
+	{
+		size_t	fRepetitions {};
+
+		double	fMin_ns {};
+		double	fMedian_ns {};
+		double	fMean_ns {};
+		double	fStdDev_ns {};
+
+		double	fGBps {};			// the bytes of both input vectors per the median time
+		double	fGFLOPs {};			// the nominal 2 n flops (n mul + n add) per the median time
+	};
+
+
+	struct BenchmarkResult
+	{
+		std::string			fName;
+		double				fValue {};		// what the kernel returned in the last run
+		double				fErrorBound { -1.0 };	// its a-posteriori error bound, -1 if not asked for
+		double				fCondition { -1.0 };	// and the condition number estimate
+		BenchmarkStats		fStats;
+	};
+
+
+
+	// All of the inner product kernels, each registered once under its name.
+	// The benchmark driver runs them in the order of registration,
+	// so a new kernel needs only a call to Register().
+	class BenchmarkRegistry
+	{
+		public:
+
+			// A kernel computes the inner product of v and w;
+			// the parallel ones split the data in chunks of kChunkSize.
+			// If res is not null, the kernel also puts there its value with
+			// the a-posteriori error bound and the condition number (see
+			// ErrorBound.h), from the same pass over the data.
+			// The data is viewed, not owned, so it can be a mapped file as well.
+			using Kernel = std::function< double( const DataView & v, const DataView & w, size_t kChunkSize, InnerProductResult * res ) >;
+
+			// A kernel of the float32 data - it is run on the data set rounded to float
+			using FloatKernel = std::function< double( const FloatView & v, const FloatView & w, size_t kChunkSize, InnerProductResult * res ) >;
+
+			struct Entry
+			{
+				std::string		fName;
+				Kernel			fKernel;			// empty if it does not take double data
+				FloatKernel		fFloatKernel;		// empty if it does not take float data
+				bool			fTuned {};			// true if it runs with RunTuned (see AutoTune.h)
+
+				// True if the kernel takes the data of type T
+				template < typename T >
+				bool Takes( void ) const { return std::is_same_v< T, float > ? bool( fFloatKernel ) : bool( fKernel ); }
+
+				template < typename T >
+				double Run( const BasicDataView< T > & v, const BasicDataView< T > & w, const size_t kChunkSize, InnerProductResult * res = nullptr ) const
+				{
+					if constexpr( std::is_same_v< T, float > )
+						return fFloatKernel( v, w, kChunkSize, res );
+					else
+						return fKernel( v, w, kChunkSize, res );
+				}
+			};
+
+		private:
+
+			std::vector< Entry >	fEntries;
+
+			BenchmarkRegistry( void ) = default;
+
+		public:
+
+			static BenchmarkRegistry & Instance( void )
+			{
+				static BenchmarkRegistry	theRegistry;
+				return theRegistry;
+			}
+
+			// Returns true, so it can initialize a static flag.
+			// kTuned is true for the kernels which take their chunk size
+			// and thread count from the AutoTuner.
+			bool Register( const std::string & name, Kernel kernel, const bool kTuned = false )
+			{
+				fEntries.push_back( { name, std::move( kernel ), {}, kTuned } );
+				return true;
+			}
+
+			bool RegisterFloat( const std::string & name, FloatKernel kernel )
+			{
+				fEntries.push_back( { name, {}, std::move( kernel ) } );
+				return true;
+			}
+
+			// A kernel of both the double and the float data, i.e. a generic
+			// lambda which calls the kernel templated on the type of the data
+			template < typename K >
+			bool RegisterGeneric( const std::string & name, K kernel, const bool kTuned = false )
+			{
+				fEntries.push_back( { name, kernel, kernel, kTuned } );
+				return true;
+			}
+
+			// Sets the kernel of a registered one, e.g. with the parameters
+			// of the experiment, in the same place of the order.
+			// Returns false if there is no such entry.
+			bool Replace( const std::string & name, Kernel kernel )
+			{
+				for( auto & entry : fEntries )
+					if( entry.fName == name && entry.fKernel )
+					{
+						entry.fKernel = std::move( kernel );
+						return true;
+					}
+
+				return false;
+			}
+
+			const std::vector< Entry > & Entries( void ) const { return fEntries; }
+	};
+
+
+
+	///////////////////////////////////////////////////////////
+	// Measures a registered kernel
+	///////////////////////////////////////////////////////////
+	//
+	// INPUT:
+	//		entry - the kernel to run
+	//		v, w - the input vectors, double or float (for the
+	//			float kernels, see Entry::Takes)
+	//		kChunkSize - passed to the kernel
+	//		settings - number of warm-ups and repetitions,
+	//			and whether the error bound is computed
+	// OUTPUT:
+	//		the value returned by the kernel (and its error bound
+	//		and condition number, if asked for) and the timing statistics
+	//
+	// REMARKS:
+	//		Each repetition is timed separately with steady_clock
+	//		in nanoseconds. The throughput is computed from the median,
+	//		which is less prone to the outliers than the mean.
+	//
+	template < typename T >
+	BenchmarkResult RunBenchmark( const BenchmarkRegistry::Entry & entry,
+								  const BasicDataView< T > & v, const BasicDataView< T > & w, const size_t kChunkSize,
+								  const BenchmarkSettings & settings = BenchmarkSettings() )
+	{
+		using timer = std::chrono::steady_clock;
+
+		BenchmarkResult		result;
+		result.fName = entry.fName;
+
+		auto run = [ & ] ()
+		{
+			if( ! settings.fErrorBound )
+			{
+				result.fValue = entry.Run( v, w, kChunkSize );
+				return;
+			}
+
+			InnerProductResult	res;
+			result.fValue = entry.Run( v, w, kChunkSize, & res );
+			result.fErrorBound = res.fErrorBound;
+			result.fCondition = res.fCondition;
+		};
+
+		for( size_t i = 0; i < settings.fWarmUps; ++ i )
+			run();
+
+		std::vector< double >	times_ns;
+
+		const auto kStart = timer::now();
+		const auto kBudget = std::chrono::duration< double >( settings.fTimeBudget_s );
+
+		for( size_t i = 0; i < std::max( settings.fRepetitions, size_t( 1 ) ); ++ i )
+		{
+			if( i > 0 && timer::now() - kStart > kBudget )
+				break;
+
+			const auto ts = timer::now();
+			run();
+			times_ns.push_back( double( std::chrono::duration_cast< std::chrono::nanoseconds >( timer::now() - ts ).count() ) );
+		}
+
+		BenchmarkStats & stats = result.fStats;
+
+		const size_t kReps = times_ns.size();
+		stats.fRepetitions = kReps;
+
+		std::sort( times_ns.begin(), times_ns.end() );
+		stats.fMin_ns = times_ns.front();
+		stats.fMedian_ns = kReps % 2 ? times_ns[ kReps / 2 ] : 0.5 * ( times_ns[ kReps / 2 - 1 ] + times_ns[ kReps / 2 ] );
+		stats.fMean_ns = std::accumulate( times_ns.begin(), times_ns.end(), 0.0 ) / kReps;
+
+		double var {};
+		for( const auto t : times_ns )
+			var += ( t - stats.fMean_ns ) * ( t - stats.fMean_ns );
+		stats.fStdDev_ns = kReps > 1 ? std::sqrt( var / ( kReps - 1 ) ) : 0.0;
+
+		const double kElems = double( std::min( v.size(), w.size() ) );
+		if( stats.fMedian_ns > 0.0 )
+		{
+			// bytes / ns == GB / s, and the same for the flops
+			stats.fGBps = 2.0 * sizeof( T ) * kElems / stats.fMedian_ns;
+			stats.fGFLOPs = 2.0 * kElems / stats.fMedian_ns;
+		}
+
+		return result;
+	}
+
+
+}	// end of namespace
@@ -0,0 +1,220 @@
+#pragma once
+
+
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+#include <cmath>
+#include <cstdint>
+
+#include "Benchmark.h"
+
+
+
+namespace InnerProducts
+{
+
+
+	// The parameters of the data set a benchmark was run on
+	struct DatasetInfo
+	{
+		std::string		fType;				// e.g. "kWellConditioned"
+		int				fExpDelta {};		// dExp of the generator
+		uint64_t		fSeed {};			// seed of the generator
+		size_t			fElems {};			// length of the vectors
+		size_t			fChunkSize {};		// chunk size of the parallel kernels (of a tuned one, the one it ran with)
+		size_t			fThreads {};		// workers in the thread pool (of a tuned kernel, the ones it ran on)
+		double			fExactValue {};		// the exact inner product, the errors are relative to this
+		double			fCondition {};		// sum | v[ i ] * w[ i ] | / | fExactValue |
+	};
+
+
+	// What the results were measured on
+	struct MachineInfo
+	{
+		std::string		fCpu { "unknown" };
+		std::string		fCompiler;
+		std::string		fSimd;
+		unsigned		fHardwareThreads {};
+	};
+
+
+	inline MachineInfo GetMachineInfo( void )
+	{
+		MachineInfo		info;
+
+		// Linux only, elsewhere the CPU stays unknown
+		std::ifstream	cpuinfo( "/proc/cpuinfo" );
+		for( std::string line; std::getline( cpuinfo, line ); )
+			if( line.compare( 0, 10, "model name" ) == 0 )
+			{
+				const auto kPos = line.find( ':' );
+				if( kPos != std::string::npos )
+					info.fCpu = line.substr( line.find_first_not_of( ' ', kPos + 1 ) );
+				break;
+			}
+
+	#if defined( __clang__ )
+		info.fCompiler = "clang " __clang_version__;
+	#elif defined( __GNUC__ )
+		info.fCompiler = "gcc " __VERSION__;
+	#elif defined( _MSC_VER )
+		info.fCompiler = "msvc " + std::to_string( _MSC_VER );
+	#else
+		info.fCompiler = "unknown";
+	#endif
+
+	#if defined( __AVX512F__ )
+		info.fSimd = "AVX-512";
+	#elif defined( __AVX__ )
+		info.fSimd = "AVX";
+	#else
+		info.fSimd = "scalar";
+	#endif
+
+		info.fHardwareThreads = std::thread::hardware_concurrency();
+
+		return info;
+	}
+
+
+
+	// Appends the benchmark results as labelled records, one per algorithm and data set,
+	// to a CSV file (with a header line, written if the file is new)
+	// and to a JSON Lines file (one JSON object per line).
+	// Both can be loaded by the plotting scripts and dashboards as they are,
+	// without matching the columns by hand.
+	class BenchmarkReport
+	{
+		private:
+
+			std::string		fCsvFileName;
+			std::string		fJsonFileName;
+
+			MachineInfo		fMachine { GetMachineInfo() };
+
+		public:
+
+			BenchmarkReport( const std::string & csv_file_name = "inner_results.csv", const std::string & json_file_name = "inner_results.jsonl" )
+				: fCsvFileName( csv_file_name ), fJsonFileName( json_file_name )
+			{}
+
+			const MachineInfo & Machine( void ) const { return fMachine; }
+
+			void Write( const DatasetInfo & ds, const BenchmarkResult & res ) const
+			{
+				const std::string	kTime = TimeStamp();
+				const double		kAbsError = std::fabs( res.fValue - ds.fExactValue );
+				const auto &		st = res.fStats;
+
+				if( ! fCsvFileName.empty() )
+				{
+					const bool kIsNew = ! std::ifstream( fCsvFileName ).good();
+
+					std::ofstream	csv( fCsvFileName, std::ios::app );
+					if( kIsNew )
+						csv << "timestamp,algorithm,data_type,exp_delta,seed,n,chunk_size,threads,"
+							   "cpu,compiler,simd,hardware_threads,"
+							   "exact_value,condition,value,abs_error,error_bound,repetitions,min_ns,median_ns,mean_ns,stddev_ns,gb_per_s,gflop_per_s\n";
+
+					csv << std::setprecision( 17 )
+						<< kTime << ',' << CsvField( res.fName ) << ',' << CsvField( ds.fType ) << ',' << ds.fExpDelta << ',' << ds.fSeed << ','
+						<< ds.fElems << ',' << ds.fChunkSize << ',' << ds.fThreads << ','
+						<< CsvField( fMachine.fCpu ) << ',' << CsvField( fMachine.fCompiler ) << ',' << fMachine.fSimd << ',' << fMachine.fHardwareThreads << ','
+						<< ds.fExactValue << ',' << ds.fCondition << ','
+						<< res.fValue << ',' << kAbsError << ',' << CsvBound( res.fErrorBound ) << ',' << st.fRepetitions << ','
+						<< st.fMin_ns << ',' << st.fMedian_ns << ',' << st.fMean_ns << ',' << st.fStdDev_ns << ','
+						<< st.fGBps << ',' << st.fGFLOPs << '\n';
+				}
+
+				if( ! fJsonFileName.empty() )
+				{
+					std::ofstream	json( fJsonFileName, std::ios::app );
+					json << std::setprecision( 17 )
+						 << "{\"timestamp\":" << JsonString( kTime ) << ",\"algorithm\":" << JsonString( res.fName )
+						 << ",\"dataset\":{\"type\":" << JsonString( ds.fType ) << ",\"exp_delta\":" << ds.fExpDelta << ",\"seed\":" << ds.fSeed
+						 << ",\"n\":" << ds.fElems << ",\"chunk_size\":" << ds.fChunkSize << ",\"threads\":" << ds.fThreads
+						 << ",\"exact_value\":" << JsonNumber( ds.fExactValue ) << ",\"condition\":" << JsonNumber( ds.fCondition ) << "}"
+						 << ",\"machine\":{\"cpu\":" << JsonString( fMachine.fCpu ) << ",\"compiler\":" << JsonString( fMachine.fCompiler )
+						 << ",\"simd\":" << JsonString( fMachine.fSimd ) << ",\"hardware_threads\":" << fMachine.fHardwareThreads << "}"
+						 << ",\"value\":" << JsonNumber( res.fValue ) << ",\"abs_error\":" << JsonNumber( kAbsError )
+						 << ",\"error_bound\":" << ( res.fErrorBound < 0.0 ? std::string( "null" ) : JsonNumber( res.fErrorBound ) )
+						 << ",\"timing\":{\"repetitions\":" << st.fRepetitions << ",\"min_ns\":" << st.fMin_ns << ",\"median_ns\":" << st.fMedian_ns
+						 << ",\"mean_ns\":" << st.fMean_ns << ",\"stddev_ns\":" << st.fStdDev_ns
+						 << ",\"gb_per_s\":" << st.fGBps << ",\"gflop_per_s\":" << st.fGFLOPs << "}}\n";
+				}
+			}
+
+		private:
+
+			// ISO 8601, UTC
+			static std::string TimeStamp( void )
+			{
+				const std::time_t kNow = std::chrono::system_clock::to_time_t( std::chrono::system_clock::now() );
+				char buf[ 32 ] {};
+				std::strftime( buf, sizeof( buf ), "%Y-%m-%dT%H:%M:%SZ", std::gmtime( & kNow ) );
+				return buf;
+			}
+
+			// An empty field if the kernel gives no bound
+			static std::string CsvBound( const double bound )
+			{
+				if( bound < 0.0 )
+					return {};
+
+				std::ostringstream	os;
+				os << std::setprecision( 17 ) << bound;
+				return os.str();
+			}
+
+			// Quotes the field if it contains a separator or a quote
+			static std::string CsvField( const std::string & s )
+			{
+				if( s.find_first_of( ",\"\n" ) == std::string::npos )
+					return s;
+
+				std::string out { "\"" };
+				for( const char c : s )
+					out += c == '"' ? std::string( "\"\"" ) : std::string( 1, c );
+				return out + "\"";
+			}
+
+			static std::string JsonString( const std::string & s )
+			{
+				std::string out { "\"" };
+				for( const char c : s )
+				{
+					if( c == '"' || c == '\\' )
+						( out += '\\' ) += c;
+					else if( static_cast< unsigned char >( c ) < 0x20 )
+					{
+						char buf[ 8 ] {};
+						std::snprintf( buf, sizeof( buf ), "\\u%04x", c );
+						out += buf;
+					}
+					else
+						out += c;
+				}
+				return out + "\"";
+			}
+
+			// JSON has no inf nor NaN
+			static std::string JsonNumber( const double x )
+			{
+				if( ! std::isfinite( x ) )
+					return "null";
+
+				std::ostringstream	os;
+				os << std::setprecision( 17 ) << x;
+				return os.str();
+			}
+	};
+
+
+}	// end of namespace
@@ -0,0 +1,139 @@
+#pragma once
+
+
+
+#include <vector>
+#include <future>
+#include <algorithm>
+#include <cassert>
+
+#include "InnerProductSIMD.h"
+#include "ThreadPool.h"
+
+
+
+// Many inner products of one vector x against the rows of a matrix A,
+// i.e. y = A x, each with the compensated (Kahan) summation of
+// InnerProduct_KahanAlg_SIMD. Instead of streaming x once per row,
+// x is read in blocks which stay in L1 while all of the rows of a block
+// of rows go over it.
+
+namespace InnerProducts
+{
+
+
+	namespace Detail
+	{
+		constexpr size_t kGemvColBlock { 2048 };	// 16 KB of x, to stay in L1 (the cache block)
+
+		static_assert( kGemvColBlock % kKahanSIMDLanes == 0, "the blocks must not leave a tail in the lanes" );
+	}
+
+
+
+	///////////////////////////////////////////////////////////
+	// Compensated matrix-vector product of a block of rows
+	///////////////////////////////////////////////////////////
+	//
+	// INPUT:
+	//		A - the row-major matrix, the row r starts at A + r * lda
+	//		kRowFrom, kRowTo - the rows to compute, [from,to)
+	//		kCols - number of columns of A ( == size of x )
+	//		lda - the distance between the rows of A (>= kCols)
+	//		x - the vector
+	//		y - the results, y[ r ] for r in [from,to)
+	// OUTPUT:
+	//		none
+	//
+	// REMARKS:
+	//		The columns are taken in blocks of kGemvColBlock. Each row
+	//		keeps the Kahan lanes of InnerProduct_KahanAlg_SIMD between
+	//		the blocks (see Detail::KahanLanes_SIMD), and the lanes are
+	//		merged by MergeKahanLanes - so y[ r ] is the same as
+	//		InnerProduct_KahanAlg_SIMD of the row r and x.
+	//
+	inline void GEMV_KahanAlg( const double * A, const size_t kRowFrom, const size_t kRowTo, const size_t kCols, const size_t lda,
+							   const double * x, double * y )
+	{
+		using namespace Detail;
+
+		if( kRowFrom >= kRowTo )
+			return;
+
+		const size_t kRows { kRowTo - kRowFrom };
+
+		std::vector< double >	lane_sum( kRows * kKahanSIMDLanes ), lane_c( kRows * kKahanSIMDLanes );
+
+		// The lanes of the row r
+		auto sum_of = [ & ] ( size_t r ) { return lane_sum.data() + ( r - kRowFrom ) * kKahanSIMDLanes; };
+		auto c_of = [ & ] ( size_t r ) { return lane_c.data() + ( r - kRowFrom ) * kKahanSIMDLanes; };
+
+		for( size_t j0 = 0; j0 < kCols; j0 += kGemvColBlock )
+		{
+			const size_t kJ1 = std::min( j0 + kGemvColBlock, kCols );
+
+			for( size_t r = kRowFrom; r < kRowTo; ++ r )
+				KahanLanes_SIMD< false >( A + r * lda + j0, x + j0, kJ1 - j0, sum_of( r ), c_of( r ), nullptr );
+		}
+
+		for( size_t r = kRowFrom; r < kRowTo; ++ r )
+			y[ r ] = MergeKahanLanes( sum_of( r ), c_of( r ), kKahanSIMDLanes );
+	}
+
+
+
+	///////////////////////////////////////////////////////////
+	// Compensated matrix-vector product, in parallel over the rows
+	///////////////////////////////////////////////////////////
+	//
+	// INPUT:
+	//		A - the row-major matrix, the row r starts at A + r * lda
+	//		kRows, kCols - the dimensions of A
+	//		lda - the distance between the rows of A (>= kCols)
+	//		x - the vector of kCols elements
+	//		y - the kRows results
+	//		kRowBlock - the rows of a task of the pool; 0 means
+	//			a few blocks per worker
+	// OUTPUT:
+	//		none
+	//
+	// REMARKS:
+	//		Each y[ r ] is the same as from GEMV_KahanAlg,
+	//		regardless of the number of threads.
+	//
+	inline void GEMV_KahanAlg_Par( const double * A, const size_t kRows, const size_t kCols, const size_t lda,
+								   const double * x, double * y, size_t kRowBlock = 0 )
+	{
+		ThreadPool &	pool = GetThreadPool();
+
+		if( kRowBlock == 0 )
+			kRowBlock = std::max( ( kRows + 4 * pool.size() - 1 ) / ( 4 * pool.size() ), size_t( 1 ) );
+
+		std::vector< std::future< void > >	blocks;
+		for( size_t r = 0; r < kRows; r += kRowBlock )
+			blocks.push_back( pool.Submit( [ = ] () { GEMV_KahanAlg( A, r, std::min( r + kRowBlock, kRows ), kCols, lda, x, y ); } ) );
+
+		for( auto & b : blocks )
+			pool.Get( b );
+	}
+
+
+	// y = A x for a row-major kRows x x.size() matrix in a vector;
+	// y is empty if the size of A is not a multiple of the size of x
+	inline std::vector< double > GEMV_KahanAlg_Par( const std::vector< double > & A, const std::vector< double > & x )
+	{
+		const size_t kCols { x.size() };
+
+		assert( kCols > 0 ? A.size() % kCols == 0 : A.empty() );
+		if( kCols == 0 || A.size() % kCols != 0 )
+			return {};
+
+		const size_t kRows { A.size() / kCols };
+
+		std::vector< double >	y( kRows );
+		GEMV_KahanAlg_Par( A.data(), kRows, kCols, kCols, x.data(), y.data() );
+		return y;
+	}
+
+
+}	// end of namespace
@@ -0,0 +1,69 @@
+#pragma once
+
+
+
+#include <cstdint>
+#include <array>
+
+
+
+// Counter-based random numbers: the n-th random number is a pure function
+// of ( key, n ), so any element of a data set can be generated independently
+// of the others - in any order and by any number of threads - and the result
+// depends only on the seed.
+
+namespace InnerProducts
+{
+
+
+	// Philox4x32-10 by Salmon, Moraes, Dror and Shaw,
+	// "Parallel random numbers: as easy as 1, 2, 3", SC'11.
+	// Maps a 128-bit counter to 128 random bits under a 64-bit key.
+	class Philox4x32
+	{
+		public:
+
+			using Counter = std::array< uint32_t, 4 >;
+
+		private:
+
+			uint32_t	fKey[ 2 ];
+
+			static constexpr uint32_t	kMul0 { 0xD2511F53 }, kMul1 { 0xCD9E8D57 };
+			static constexpr uint32_t	kWeyl0 { 0x9E3779B9 }, kWeyl1 { 0xBB67AE85 };
+
+			static constexpr int		kRounds { 10 };
+
+		public:
+
+			explicit Philox4x32( const uint64_t key ) : fKey { uint32_t( key ), uint32_t( key >> 32 ) } {}
+
+			Counter operator() ( Counter c ) const
+			{
+				uint32_t k0 = fKey[ 0 ], k1 = fKey[ 1 ];
+
+				for( int r = 0; r < kRounds; ++ r )
+				{
+					const uint64_t p0 = uint64_t( kMul0 ) * c[ 0 ];
+					const uint64_t p1 = uint64_t( kMul1 ) * c[ 2 ];
+
+					c = { uint32_t( p1 >> 32 ) ^ c[ 1 ] ^ k0, uint32_t( p1 ),
+						  uint32_t( p0 >> 32 ) ^ c[ 3 ] ^ k1, uint32_t( p0 ) };
+
+					k0 += kWeyl0;
+					k1 += kWeyl1;
+				}
+
+				return c;
+			}
+
+			// 128 random bits for the index i of the stream s, as two 64-bit words
+			std::array< uint64_t, 2 > Bits128( const uint64_t i, const uint64_t s = 0 ) const
+			{
+				const Counter r = ( * this )( { uint32_t( i ), uint32_t( i >> 32 ), uint32_t( s ), uint32_t( s >> 32 ) } );
+				return { uint64_t( r[ 0 ] ) | uint64_t( r[ 1 ] ) << 32, uint64_t( r[ 2 ] ) | uint64_t( r[ 3 ] ) << 32 };
+			}
+	};
+
+
+}	// end of namespace
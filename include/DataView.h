@@ -0,0 +1,50 @@
+#pragma once
+
+
+
+#include <vector>
+#include <cstddef>
+
+
+
+namespace InnerProducts
+{
+
+
+	// A read-only view of a contiguous array of T (as std::span<const T>
+	// in C++20). It is what the kernels take, so they run on a std::vector
+	// and on a memory-mapped data file alike, without copying.
+	template < typename T >
+	class BasicDataView
+	{
+		private:
+
+			const T *		fData {};
+			size_t			fSize {};
+
+		public:
+
+			using value_type = T;
+			using size_type = size_t;
+			using const_iterator = const T *;
+
+			BasicDataView( void ) = default;
+			BasicDataView( const T * data, const size_t size ) : fData( data ), fSize( size ) {}
+			BasicDataView( const std::vector< T > & v ) : fData( v.data() ), fSize( v.size() ) {}
+
+			const T * data( void ) const { return fData; }
+			size_t size( void ) const { return fSize; }
+			bool empty( void ) const { return fSize == 0; }
+
+			const T * begin( void ) const { return fData; }
+			const T * end( void ) const { return fData + fSize; }
+
+			const T & operator [] ( const size_t i ) const { return fData[ i ]; }
+	};
+
+
+	using DataView = BasicDataView< double >;
+	using FloatView = BasicDataView< float >;		// the float32 data, see InnerProductSIMD.h
+
+
+}	// end of namespace
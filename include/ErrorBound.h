@@ -0,0 +1,132 @@
+#pragma once
+
+
+
+#include <cstddef>
+#include <cmath>
+#include <limits>
+
+
+
+// A-posteriori error bounds of the inner products. An engine which keeps
+// the sum S = sum | v[ i ] * w[ i ] | next to its result (in the same pass
+// over the data) knows how far the result can be from the exact value,
+// and how ill-conditioned the data is, with no second pass and no
+// exact reference.
+
+namespace InnerProducts
+{
+
+
+	// What an engine returns on request, next to its value
+	struct InnerProductResult
+	{
+		double	fValue {};			// the computed inner product
+		double	fErrorBound {};		// | fValue - exact | <= fErrorBound (barring underflow), infinity if not known
+		double	fAbsSum {};			// an upper bound of sum | v[ i ] * w[ i ] |
+		double	fCondition {};		// the condition number estimate fAbsSum / | fValue |
+	};
+
+
+	// The unit roundoff of A, e.g. 2^-53 for double
+	template < typename A >
+	constexpr double UnitRoundoff( void )
+	{
+		return double( std::numeric_limits< A >::epsilon() ) / 2.0;
+	}
+
+
+	// Higham's gamma_n = n u / ( 1 - n u ), or infinity if n u >= 1
+	inline double Gamma( const size_t n, const double u = UnitRoundoff< double >() )
+	{
+		const double kNU = double( n ) * u;
+		return kNU < 1.0 ? kNU / ( 1.0 - kNU ) : std::numeric_limits< double >::infinity();
+	}
+
+
+	// The upper bound of sum | v[ i ] * w[ i ] | given its computed value,
+	// the recursive sum of kTerms rounded | products | (of the lanes, chunks, etc.)
+	inline double AbsSumBound( const double abs_sum, const size_t kTerms )
+	{
+		const double kG = Gamma( kTerms + 1 );
+		return kG < 1.0 ? abs_sum / ( 1.0 - kG ) : std::numeric_limits< double >::infinity();
+	}
+
+
+	// Any summation of the n rounded products in the precision with the unit
+	// roundoff u - recursive, or in lanes, chunks or a tree, since each product
+	// goes through at most n - 1 additions: | E | <= gamma_n S  (Higham, 3.5)
+	inline double RecursiveSumErrorBound( const size_t n, const double abs_sum, const double u = UnitRoundoff< double >() )
+	{
+		return Gamma( n, u ) * abs_sum;
+	}
+
+
+	// The Kahan summation of the n rounded products in kLanes lanes, their
+	// compensated merge and the rounding to double (the value term is u of
+	// the accumulation plus u of double):
+	// | E | <= ( 3 u + gamma_2( n + lanes )^2 ) S + 2 u | value |  (Higham, 4.9)
+	inline double KahanErrorBound( const size_t n, const size_t kLanes, const double value, const double abs_sum,
+									const double u = UnitRoundoff< double >() )
+	{
+		const double kG = Gamma( 2 * ( n + kLanes ), u );
+		return ( 3.0 * u + kG * kG ) * abs_sum + ( u + UnitRoundoff< double >() ) * std::fabs( value );
+	}
+
+
+	// Dot2 of Ogita, Rump, Oishi (Theorem 5.3): | res - exact | <= u | exact | + gamma_n^2 S,
+	// with n grown by the merge of the kLanes lanes; | exact | <= | res | + the error
+	inline double Dot2ErrorBound( const size_t n, const size_t kLanes, const double value, const double abs_sum )
+	{
+		const double kU = UnitRoundoff< double >();
+		const double kG = Gamma( n + 2 * kLanes, kU );
+		return ( kU * std::fabs( value ) + kG * kG * abs_sum ) / ( 1.0 - kU );
+	}
+
+
+	// The double-double sum of the exact products (TwoProduct) in kAdds additions
+	// (the products, and the merges of the lanes and chunks) and the rounding
+	// to double. Each AccurateDWPlusDW errs by at most 3 u^2 of the partial sum,
+	// which is at most S ( 1 + gamma ) <= 4/3 S for kAdds u <= 1/4.
+	inline double DoubleDoubleErrorBound( const size_t kAdds, const double value, const double abs_sum )
+	{
+		const double kU = UnitRoundoff< double >();
+		if( double( kAdds ) * kU > 0.25 )
+			return std::numeric_limits< double >::infinity();
+		return kU * std::fabs( value ) + 4.0 * double( kAdds ) * kU * kU * abs_sum;
+	}
+
+
+	///////////////////////////////////////////////////////////
+	// Puts together the result of an engine
+	///////////////////////////////////////////////////////////
+	//
+	// INPUT:
+	//		value - the computed inner product
+	//		abs_sum - an upper bound of sum | v[ i ] * w[ i ] |
+	//		bound - the error bound of the engine
+	// OUTPUT:
+	//		the result with the condition number estimate
+	//
+	// REMARKS:
+	//		The bound is enlarged by a few ulps, to cover the roundings
+	//		of its own computation. If the value is 0, then the condition
+	//		number is infinite (unless all products are 0 too).
+	//
+	inline InnerProductResult MakeInnerProductResult( const double value, const double abs_sum, const double bound )
+	{
+		InnerProductResult	res;
+		res.fValue = value;
+		res.fAbsSum = abs_sum;
+		res.fErrorBound = bound * ( 1.0 + 8.0 * UnitRoundoff< double >() );
+
+		if( value != 0.0 )
+			res.fCondition = abs_sum / std::fabs( value );
+		else
+			res.fCondition = abs_sum == 0.0 ? 1.0 : std::numeric_limits< double >::infinity();
+
+		return res;
+	}
+
+
+}	// end of namespace
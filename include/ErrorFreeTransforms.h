@@ -0,0 +1,72 @@
+#pragma once
+
+
+
+#include <cmath>
+
+
+
+// Error-free transformations of the floating-point operations.
+// Each of them returns the rounded result and its exact rounding error,
+// so that a + b == s + e (or a * b == p + e) holds exactly.
+//
+// Beware: these must not be compiled with -ffast-math (or /fp:fast)
+// since the compiler would then "simplify" the error terms to zero.
+
+namespace InnerProducts
+{
+
+
+	// Knuth's TwoSum: s + e == a + b, for any magnitudes of a and b
+	inline void TwoSum( const double a, const double b, double & s, double & e )
+	{
+		s = a + b;
+		const double z = s - a;
+		e = ( a - ( s - z ) ) + ( b - z );
+	}
+
+	// Dekker's FastTwoSum: s + e == a + b, requires |a| >= |b|
+	inline void FastTwoSum( const double a, const double b, double & s, double & e )
+	{
+		s = a + b;
+		e = b - ( s - a );
+	}
+
+	// TwoProduct with FMA: p + e == a * b (barring underflow)
+	inline void TwoProduct( const double a, const double b, double & p, double & e )
+	{
+		p = a * b;
+		e = std::fma( a, b, - p );
+	}
+
+
+
+	// An unevaluated sum fHi + fLo, in which fHi holds the rounded sum
+	// and fLo collects the rounding errors. This is how the compensated
+	// kernels return their partial results so these can be merged
+	// without losing the compensation.
+	struct CompensatedSum
+	{
+		double	fHi {};
+		double	fLo {};
+
+		// Adds x to fHi, its rounding error goes to fLo
+		void Add( const double x )
+		{
+			double e {};
+			TwoSum( fHi, x, fHi, e );
+			fLo += e;
+		}
+
+		// Merges another partial result
+		void Add( const CompensatedSum & cs )
+		{
+			Add( cs.fHi );
+			fLo += cs.fLo;
+		}
+
+		double Value( void ) const { return fHi + fLo; }
+	};
+
+
+}	// end of namespace
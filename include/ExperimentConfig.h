@@ -0,0 +1,277 @@
+#pragma once
+
+
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <ostream>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+#include "Benchmark.h"
+
+
+
+namespace InnerProducts
+{
+
+
+	// The data types of the experiment, in the order of FP_TestData_Type
+	inline const std::vector< std::string > kDataTypeNames { "kWellConditioned", "kRandom", "kAnderson", "kExactSumIsZero", "kMersenneRand_InnerZero" };
+
+
+	// What InnerProduct_Test_GeneralExperiment runs - all combinations
+	// of the data types, exponents, sizes, thread counts and chunk sizes.
+	// The defaults are those of the paper.
+	struct ExperimentConfig
+	{
+		std::vector< std::string >	fAlgorithms;								// the registered names, empty means all
+		std::vector< std::string >	fDataTypes { kDataTypeNames };
+		std::vector< int >			fExpDeltas { 10, 30, 50, 100, 300, 500 };
+		std::vector< size_t >		fSizes { 20000000 };
+		std::vector< size_t >		fThreads { 0 };								// 0 means all hardware threads
+		std::vector< size_t >		fChunkSizes { 0 };							// 0 means tuned, see AutoTune.h
+
+		BenchmarkSettings			fSettings;
+
+		double						fTolerance { 1e-12 };						// the relative error allowed to the "Auto" engine
+
+		uint64_t					fSeed { 908 };
+		std::string					fOutput { "inner_results" };				// .csv and .jsonl are appended
+		std::string					fCacheDir { "ip_datasets" };				// empty means no caching
+		std::string					fTuningFile { "ip_tuning.txt" };			// the AutoTuner profile
+
+		bool						fPin {};									// pin the workers, node by node
+		bool						fNuma {};									// and place the data on the nodes of the workers
+
+		bool						fMatrix { true };							// check and time the matrix kernels on each data set
+
+		bool						fListAlgorithms {};
+		bool						fHelp {};
+	};
+
+
+	inline void PrintUsage( std::ostream & os, const char * prog )
+	{
+		os	<< "Usage: " << prog << " [options]\n"
+			<< "  -a, --algorithms LIST   the algorithms to run (default all, see --list)\n"
+			<< "  -t, --types LIST        data types: kWellConditioned, kRandom, kAnderson,\n"
+			<< "                          kExactSumIsZero, kMersenneRand_InnerZero (default all)\n"
+			<< "  -e, --exp LIST          exponent differences (default 10,30,50,100,300,500)\n"
+			<< "  -n, --sizes LIST        vector lengths (default 20000000)\n"
+			<< "  -j, --threads LIST      thread counts up to 4096, 0 for all hardware threads (default 0)\n"
+			<< "  -c, --chunks LIST       chunk sizes of the parallel kernels, 0 for the tuned\n"
+			<< "                          chunk size and thread count (default 0)\n"
+			<< "  -r, --reps N            timed repetitions (default 5)\n"
+			<< "  -w, --warmups N         untimed runs before them (default 1)\n"
+			<< "  -b, --budget SEC        time budget of the repetitions of a kernel (default 2)\n"
+			<< "      --no-bound          do not compute the error bounds in the timed runs\n"
+			<< "      --tolerance TOL     relative error allowed to the Auto engine (default 1e-12)\n"
+			<< "  -s, --seed N            seed of the data generator (default 908)\n"
+			<< "  -o, --output NAME       results go to NAME.csv and NAME.jsonl (default inner_results)\n"
+			<< "      --cache DIR         data set cache directory, \"\" for none (default ip_datasets)\n"
+			<< "      --tuning FILE       the tuned parameters (default ip_tuning.txt)\n"
+			<< "      --pin               pin the workers to the CPUs, node by node\n"
+			<< "      --numa              --pin, and the data is first touched by the workers of\n"
+			<< "                          the first thread count, then moved to the nodes of the others\n"
+			<< "      --no-matrix         do not check and time the matrix kernels\n"
+			<< "  -l, --list              list the algorithms and exit\n"
+			<< "  -h, --help              this text\n"
+			<< "A LIST is comma separated; a numeric item can also be a range from:to[:step],\n"
+			<< "e.g. --exp 10:50:10,100 is 10,20,30,40,50,100\n";
+	}
+
+
+	// The upper limits of the lists of the command line
+	constexpr size_t kMaxThreads { 4096 };			// per --threads item
+	constexpr size_t kMaxListItems { 100000 };		// items of a list, after the ranges are expanded
+
+
+	namespace Detail
+	{
+		inline std::vector< std::string > SplitList( const std::string & s )
+		{
+			std::vector< std::string >	items;
+			std::istringstream			iss( s );
+			for( std::string item; std::getline( iss, item, ',' ); )
+				if( ! item.empty() )
+					items.push_back( item );
+			return items;
+		}
+
+		// Parses the whole of s to val; returns false if not a number
+		// (or negative, for an unsigned T - which >> would wrap around)
+		template < typename T >
+		bool ParseNumber( const std::string & s, T & val )
+		{
+			if( std::is_unsigned_v< T > && s.find( '-' ) != std::string::npos )
+				return false;
+
+			std::istringstream	iss( s );
+			return ( iss >> val ) && iss.peek() == std::char_traits< char >::eof();
+		}
+
+		// Parses a list of numbers and ranges from:to[:step]
+		template < typename T >
+		bool ParseNumberList( const std::string & s, std::vector< T > & out )
+		{
+			std::vector< T >	vals;
+			for( const auto & item : SplitList( s ) )
+			{
+				std::vector< std::string >	parts;
+				std::istringstream			iss( item );
+				for( std::string p; std::getline( iss, p, ':' ); )
+					parts.push_back( p );
+
+				T from {}, to {}, step { 1 };
+				if( parts.size() == 1 && ParseNumber( parts[ 0 ], from ) )
+					vals.push_back( from );
+				else if( ( parts.size() == 2 || parts.size() == 3 ) && ParseNumber( parts[ 0 ], from ) && ParseNumber( parts[ 1 ], to )
+							&& ( parts.size() == 2 || ParseNumber( parts[ 2 ], step ) ) && step > 0 && from <= to )
+					for( T x = from; vals.size() <= kMaxListItems; x += step )
+					{
+						vals.push_back( x );
+						if( x > std::numeric_limits< T >::max() - step || x + step > to )
+							break;		// the next one is past to (or would overflow)
+					}
+				else
+					return false;
+
+				if( vals.size() > kMaxListItems )
+					return false;
+			}
+
+			if( vals.empty() )
+				return false;
+
+			out = vals;
+			return true;
+		}
+	}
+
+
+	///////////////////////////////////////////////////////////
+	// Reads the experiment settings from the command line
+	///////////////////////////////////////////////////////////
+	//
+	// INPUT:
+	//		argc, argv - as passed to main
+	//		config - the settings, the defaults are kept if not given
+	//		err - where to report a wrong option
+	// OUTPUT:
+	//		true if all options are correct
+	//
+	// REMARKS:
+	//		The algorithm names are not checked here, since
+	//		they are known only to the benchmark registry.
+	//
+	inline bool ParseCommandLine( const int argc, const char * const argv[], ExperimentConfig & config, std::ostream & err )
+	{
+		for( int i = 1; i < argc; ++ i )
+		{
+			const std::string kOpt { argv[ i ] };
+
+			auto is = [ & kOpt ] ( const char * kShort, const char * kLong ) { return kOpt == kShort || kOpt == kLong; };
+
+			if( is( "-h", "--help" ) )
+			{
+				config.fHelp = true;
+				continue;
+			}
+			if( is( "-l", "--list" ) )
+			{
+				config.fListAlgorithms = true;
+				continue;
+			}
+			if( kOpt == "--no-matrix" )
+			{
+				config.fMatrix = false;
+				continue;
+			}
+			if( kOpt == "--no-bound" )
+			{
+				config.fSettings.fErrorBound = false;
+				continue;
+			}
+			if( kOpt == "--pin" || kOpt == "--numa" )
+			{
+				config.fPin = true;
+				config.fNuma = config.fNuma || kOpt == "--numa";
+				continue;
+			}
+
+			// All other options take a value
+			if( i + 1 >= argc )
+			{
+				err << "Missing value of " << kOpt << std::endl;
+				return false;
+			}
+			const std::string kVal { argv[ ++ i ] };
+
+			bool ok { true };
+
+			if( is( "-a", "--algorithms" ) )
+			{
+				config.fAlgorithms = Detail::SplitList( kVal );
+				ok = ! config.fAlgorithms.empty();
+			}
+			else if( is( "-t", "--types" ) )
+			{
+				config.fDataTypes = Detail::SplitList( kVal );
+				ok = ! config.fDataTypes.empty();
+				for( const auto & t : config.fDataTypes )
+					if( std::find( kDataTypeNames.begin(), kDataTypeNames.end(), t ) == kDataTypeNames.end() )
+					{
+						err << "Unknown data type " << t << std::endl;
+						return false;
+					}
+			}
+			else if( is( "-e", "--exp" ) )
+				ok = Detail::ParseNumberList( kVal, config.fExpDeltas )
+						&& std::all_of( config.fExpDeltas.begin(), config.fExpDeltas.end(), [] ( int e ) { return e >= 0; } );
+			else if( is( "-n", "--sizes" ) )
+				ok = Detail::ParseNumberList( kVal, config.fSizes )
+						&& std::find( config.fSizes.begin(), config.fSizes.end(), size_t( 0 ) ) == config.fSizes.end();
+			else if( is( "-j", "--threads" ) )
+				ok = Detail::ParseNumberList( kVal, config.fThreads )
+						&& std::all_of( config.fThreads.begin(), config.fThreads.end(), [] ( size_t t ) { return t <= kMaxThreads; } );
+			else if( is( "-c", "--chunks" ) )
+				ok = Detail::ParseNumberList( kVal, config.fChunkSizes );
+			else if( is( "-r", "--reps" ) )
+				ok = Detail::ParseNumber( kVal, config.fSettings.fRepetitions ) && config.fSettings.fRepetitions > 0;
+			else if( is( "-w", "--warmups" ) )
+				ok = Detail::ParseNumber( kVal, config.fSettings.fWarmUps );
+			else if( is( "-b", "--budget" ) )
+				ok = Detail::ParseNumber( kVal, config.fSettings.fTimeBudget_s ) && config.fSettings.fTimeBudget_s >= 0.0;
+			else if( kOpt == "--tolerance" )
+				ok = Detail::ParseNumber( kVal, config.fTolerance ) && config.fTolerance >= 0.0;
+			else if( is( "-s", "--seed" ) )
+				ok = Detail::ParseNumber( kVal, config.fSeed );
+			else if( is( "-o", "--output" ) )
+				ok = ! ( config.fOutput = kVal ).empty();
+			else if( kOpt == "--cache" )
+				config.fCacheDir = kVal;
+			else if( kOpt == "--tuning" )
+				ok = ! ( config.fTuningFile = kVal ).empty();
+			else
+			{
+				err << "Unknown option " << kOpt << std::endl;
+				return false;
+			}
+
+			if( ! ok )
+			{
+				err << "Wrong value of " << kOpt << ": " << kVal << std::endl;
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+
+}	// end of namespace
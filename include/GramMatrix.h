@@ -0,0 +1,367 @@
+#pragma once
+
+
+
+#include <vector>
+#include <future>
+#include <algorithm>
+#include <cmath>
+
+#include "ErrorFreeTransforms.h"
+#include "InnerProductSIMD.h"
+#include "ThreadPool.h"
+
+
+
+// The Gram matrix G = V^T V of a set of vectors, i.e. all of their inner
+// products, computed with the Dot2 accumulation of InnerProduct_Dot2_SIMD
+// (as if in twice the working precision). Only the upper half of G is
+// computed, in tiles of vectors which run in parallel; within a tile the
+// elements go in blocks which stay in L2, and each loaded element is used
+// for a few inner products at once. The OrthogonalityReport then tells
+// how far the vectors are from an orthonormal set.
+
+namespace InnerProducts
+{
+
+
+	namespace Detail
+	{
+	#if defined( __AVX512F__ )
+		constexpr size_t kGramLanes { 8 };
+	#else
+		constexpr size_t kGramLanes { 4 };
+	#endif
+
+		constexpr size_t kGramRegTile { 2 };		// the register tile is kGramRegTile x kGramRegTile inner products
+		constexpr size_t kGramPairs { kGramRegTile * kGramRegTile };
+
+		constexpr size_t kGramBlock { 16 };			// the vectors of a tile of the parallel tasks
+		constexpr size_t kGramColBlock { 1024 };	// the elements of a cache block, 2 x 16 x 8 KB in L2
+
+
+		///////////////////////////////////////////////////////////
+		// Dot2 of a register tile of inner products
+		///////////////////////////////////////////////////////////
+		//
+		// INPUT:
+		//		a, b - the kGramRegTile vectors of each side
+		//		k0, k1 - the elements to process, [k0,k1)
+		//		p, s - the Dot2 lanes of the pairs, kGramLanes of
+		//			each pair ( a[ i ], b[ j ] ) at ( i * kGramRegTile + j )
+		// OUTPUT:
+		//		none
+		//
+		// REMARKS:
+		//		Each element of a and of b is loaded once for
+		//		kGramRegTile inner products. The tail of the elements
+		//		(if not a multiple of the lanes) goes to the lane 0.
+		//
+		inline void Dot2Tile( const double * const * a, const double * const * b, const size_t k0, const size_t k1, double * p, double * s )
+		{
+			size_t k { k0 };
+
+		#if defined( __AVX512F__ ) || ( defined( __AVX__ ) && defined( __FMA__ ) )
+
+		#if defined( __AVX512F__ )
+			using Reg = __m512d;
+			auto load = [] ( const double * x ) { return _mm512_loadu_pd( x ); };
+			auto store = [] ( double * x, Reg r ) { _mm512_storeu_pd( x, r ); };
+			auto add = [] ( Reg x, Reg y ) { return _mm512_add_pd( x, y ); };
+			auto sub = [] ( Reg x, Reg y ) { return _mm512_sub_pd( x, y ); };
+			auto mul = [] ( Reg x, Reg y ) { return _mm512_mul_pd( x, y ); };
+			auto fmsub = [] ( Reg x, Reg y, Reg z ) { return _mm512_fmsub_pd( x, y, z ); };
+		#else
+			using Reg = __m256d;
+			auto load = [] ( const double * x ) { return _mm256_loadu_pd( x ); };
+			auto store = [] ( double * x, Reg r ) { _mm256_storeu_pd( x, r ); };
+			auto add = [] ( Reg x, Reg y ) { return _mm256_add_pd( x, y ); };
+			auto sub = [] ( Reg x, Reg y ) { return _mm256_sub_pd( x, y ); };
+			auto mul = [] ( Reg x, Reg y ) { return _mm256_mul_pd( x, y ); };
+			auto fmsub = [] ( Reg x, Reg y, Reg z ) { return _mm256_fmsub_pd( x, y, z ); };
+		#endif
+
+			Reg pr[ kGramPairs ], sr[ kGramPairs ];
+			for( size_t q = 0; q < kGramPairs; ++ q )
+			{
+				pr[ q ] = load( p + q * kGramLanes );
+				sr[ q ] = load( s + q * kGramLanes );
+			}
+
+			for( ; k + kGramLanes <= k1; k += kGramLanes )
+			{
+				Reg ar[ kGramRegTile ], br[ kGramRegTile ];
+				for( size_t t = 0; t < kGramRegTile; ++ t )
+				{
+					ar[ t ] = load( a[ t ] + k );
+					br[ t ] = load( b[ t ] + k );
+				}
+
+				for( size_t i = 0; i < kGramRegTile; ++ i )
+					for( size_t j = 0; j < kGramRegTile; ++ j )
+					{
+						Reg & P = pr[ i * kGramRegTile + j ];
+						const Reg h = mul( ar[ i ], br[ j ] );
+						const Reg h_err = fmsub( ar[ i ], br[ j ], h );		// TwoProduct
+						const Reg t = add( P, h );							// TwoSum
+						const Reg z = sub( t, P );
+						const Reg t_err = add( sub( P, sub( t, z ) ), sub( h, z ) );
+						P = t;
+						sr[ i * kGramRegTile + j ] = add( sr[ i * kGramRegTile + j ], add( t_err, h_err ) );
+					}
+			}
+
+			for( size_t q = 0; q < kGramPairs; ++ q )
+			{
+				store( p + q * kGramLanes, pr[ q ] );
+				store( s + q * kGramLanes, sr[ q ] );
+			}
+
+		#else
+
+			// A local copy, since the lanes could alias the vectors
+			double pl[ kGramPairs ][ kGramLanes ], sl[ kGramPairs ][ kGramLanes ];
+			std::copy_n( p, kGramPairs * kGramLanes, pl[ 0 ] );
+			std::copy_n( s, kGramPairs * kGramLanes, sl[ 0 ] );
+
+			for( ; k + kGramLanes <= k1; k += kGramLanes )
+				for( size_t i = 0; i < kGramRegTile; ++ i )
+					for( size_t j = 0; j < kGramRegTile; ++ j )
+						for( size_t l = 0; l < kGramLanes; ++ l )
+						{
+							double h {}, h_err {}, t_err {};
+							TwoProduct( a[ i ][ k + l ], b[ j ][ k + l ], h, h_err );
+							TwoSum( pl[ i * kGramRegTile + j ][ l ], h, pl[ i * kGramRegTile + j ][ l ], t_err );
+							sl[ i * kGramRegTile + j ][ l ] += t_err + h_err;
+						}
+
+			std::copy_n( pl[ 0 ], kGramPairs * kGramLanes, p );
+			std::copy_n( sl[ 0 ], kGramPairs * kGramLanes, s );
+
+		#endif
+
+			for( ; k < k1; ++ k )
+				for( size_t i = 0; i < kGramRegTile; ++ i )
+					for( size_t j = 0; j < kGramRegTile; ++ j )
+					{
+						double * P = p + ( i * kGramRegTile + j ) * kGramLanes;
+						double * S = s + ( i * kGramRegTile + j ) * kGramLanes;
+						double h {}, h_err {}, t_err {};
+						TwoProduct( a[ i ][ k ], b[ j ][ k ], h, h_err );
+						TwoSum( P[ 0 ], h, P[ 0 ], t_err );
+						S[ 0 ] += t_err + h_err;
+					}
+		}
+
+
+		///////////////////////////////////////////////////////////
+		// The inner products of two blocks of vectors
+		///////////////////////////////////////////////////////////
+		//
+		// INPUT:
+		//		V - the vectors, the i-th one starts at V + i * ldv
+		//		kVecs, kElems - the number and the length of the vectors
+		//		ldv - the distance between the vectors (>= kElems)
+		//		kI, kJ - the first vectors of the blocks, kI <= kJ
+		//		G - the kVecs x kVecs Gram matrix, row-major
+		// OUTPUT:
+		//		none
+		//
+		// REMARKS:
+		//		Both G[ i, j ] and G[ j, i ] are written for i in
+		//		the block kI and j in kJ. On the diagonal block only
+		//		the register tiles with i <= j are computed. A register
+		//		tile sticking out of the blocks repeats its last vector
+		//		and the results of that are not stored.
+		//
+		inline void GramBlock( const double * V, const size_t kVecs, const size_t kElems, const size_t ldv,
+							   const size_t kI, const size_t kJ, double * G )
+		{
+			const size_t kIEnd = std::min( kI + kGramBlock, kVecs );
+			const size_t kJEnd = std::min( kJ + kGramBlock, kVecs );
+
+			constexpr size_t kTilesPerSide { ( kGramBlock + kGramRegTile - 1 ) / kGramRegTile };
+			constexpr size_t kTileLanes { kGramPairs * kGramLanes };
+
+			// The lanes of all of the register tiles, kept between the cache blocks
+			std::vector< double >	lane_p( kTilesPerSide * kTilesPerSide * kTileLanes ), lane_s( lane_p.size() );
+
+			auto vec = [ & ] ( size_t i, const size_t kEnd ) { return V + std::min( i, kEnd - 1 ) * ldv; };
+
+			for( size_t k0 = 0; k0 < kElems; k0 += kGramColBlock )
+			{
+				const size_t kK1 = std::min( k0 + kGramColBlock, kElems );
+
+				for( size_t i = kI, ti = 0; i < kIEnd; i += kGramRegTile, ++ ti )
+					for( size_t j = kJ, tj = 0; j < kJEnd; j += kGramRegTile, ++ tj )
+					{
+						if( kI == kJ && j + kGramRegTile <= i )
+							continue;		// the lower half
+
+						const double *	a[ kGramRegTile ], * b[ kGramRegTile ];
+						for( size_t t = 0; t < kGramRegTile; ++ t )
+						{
+							a[ t ] = vec( i + t, kIEnd );
+							b[ t ] = vec( j + t, kJEnd );
+						}
+
+						const size_t kOffset = ( ti * kTilesPerSide + tj ) * kTileLanes;
+						Dot2Tile( a, b, k0, kK1, lane_p.data() + kOffset, lane_s.data() + kOffset );
+					}
+			}
+
+			for( size_t i = kI, ti = 0; i < kIEnd; i += kGramRegTile, ++ ti )
+				for( size_t j = kJ, tj = 0; j < kJEnd; j += kGramRegTile, ++ tj )
+				{
+					if( kI == kJ && j + kGramRegTile <= i )
+						continue;
+
+					for( size_t ii = i; ii < std::min( i + kGramRegTile, kIEnd ); ++ ii )
+						for( size_t jj = j; jj < std::min( j + kGramRegTile, kJEnd ); ++ jj )
+						{
+							const size_t kOffset = ( ti * kTilesPerSide + tj ) * kTileLanes + ( ( ii - i ) * kGramRegTile + ( jj - j ) ) * kGramLanes;
+
+							CompensatedSum theSum;
+							for( size_t l = 0; l < kGramLanes; ++ l )
+								theSum.Add( CompensatedSum { lane_p[ kOffset + l ], lane_s[ kOffset + l ] } );
+
+							G[ ii * kVecs + jj ] = G[ jj * kVecs + ii ] = theSum.Value();
+						}
+				}
+		}
+	}
+
+
+
+	///////////////////////////////////////////////////////////
+	// Computes the Gram matrix of a set of vectors
+	///////////////////////////////////////////////////////////
+	//
+	// INPUT:
+	//		V - the vectors, the i-th one starts at V + i * ldv
+	//			(i.e. the columns of the matrix V of G = V^T V)
+	//		kVecs, kElems - the number and the length of the vectors
+	//		ldv - the distance between the vectors (>= kElems)
+	//		G - the kVecs x kVecs result, row-major (both halves are set)
+	// OUTPUT:
+	//		none
+	//
+	// REMARKS:
+	//		Each pair of blocks of kGramBlock vectors (in the upper
+	//		half) is one task of the thread pool. Each G[ i, j ] is
+	//		as accurate as InnerProduct_Dot2_SIMD, and it does not
+	//		depend on the number of threads.
+	//
+	inline void GramMatrix_Dot2_Par( const double * V, const size_t kVecs, const size_t kElems, const size_t ldv, double * G )
+	{
+		ThreadPool &	pool = GetThreadPool();
+
+		std::vector< std::future< void > >	blocks;
+		for( size_t i = 0; i < kVecs; i += Detail::kGramBlock )
+			for( size_t j = i; j < kVecs; j += Detail::kGramBlock )
+				blocks.push_back( pool.Submit( [ = ] () { Detail::GramBlock( V, kVecs, kElems, ldv, i, j, G ); } ) );
+
+		for( auto & b : blocks )
+			pool.Get( b );
+	}
+
+
+	// The Gram matrix of the vectors, all of the same size, row-major
+	inline std::vector< double > GramMatrix_Dot2_Par( const std::vector< std::vector< double > > & vecs )
+	{
+		const size_t kVecs { vecs.size() };
+		const size_t kElems { kVecs > 0 ? vecs[ 0 ].size() : 0 };
+
+		// One contiguous array, so the blocks are read with no gaps
+		std::vector< double >	V( kVecs * kElems );
+		for( size_t i = 0; i < kVecs; ++ i )
+			std::copy_n( vecs[ i ].begin(), std::min( kElems, vecs[ i ].size() ), V.begin() + i * kElems );
+
+		std::vector< double >	G( kVecs * kVecs );
+		GramMatrix_Dot2_Par( V.data(), kVecs, kElems, kElems, G.data() );
+		return G;
+	}
+
+
+
+	// How orthogonal are the vectors of a Gram matrix G
+	struct OrthogonalityReport
+	{
+		double	fMaxOffDiag {};			// max |G[ i, j ]|, i != j
+		size_t	fMaxRow {}, fMaxCol {};	// where it is
+		double	fMaxCosine {};			// max |G[ i, j ]| / sqrt( G[ i, i ] G[ j, j ] ), i != j
+		double	fMaxDiagDev {};			// max |1 - G[ i, i ]|, i.e. how far from unit vectors
+		double	fFrobenius {};			// || I - G ||_F
+		double	fMaxRowSum {};			// || I - G ||_inf, an upper bound of || I - G ||_2
+	};
+
+
+	///////////////////////////////////////////////////////////
+	// Measures the orthogonality of a set of vectors
+	///////////////////////////////////////////////////////////
+	//
+	// INPUT:
+	//		G - the kVecs x kVecs Gram matrix, row-major
+	//		kVecs - the number of vectors
+	// OUTPUT:
+	//		the distances of G from the identity
+	//
+	// REMARKS:
+	//		The squares of || I - G ||_F are summed up in the
+	//		CompensatedSum, since most of them are tiny; they are
+	//		scaled by the largest deviation, so they do not overflow
+	//		for vectors far from the unit ones.
+	//
+	inline OrthogonalityReport CheckOrthogonality( const double * G, const size_t kVecs )
+	{
+		OrthogonalityReport		report;
+		CompensatedSum			frob;
+
+		double scale {};
+		for( size_t i = 0; i < kVecs * kVecs; ++ i )
+			scale = std::max( scale, std::fabs( ( i % ( kVecs + 1 ) == 0 ? 1.0 : 0.0 ) - G[ i ] ) );
+		if( scale == 0.0 || ! std::isfinite( scale ) )
+			scale = 1.0;
+
+		for( size_t i = 0; i < kVecs; ++ i )
+		{
+			CompensatedSum	row_sum;
+			for( size_t j = 0; j < kVecs; ++ j )
+			{
+				const double kDev = std::fabs( ( i == j ? 1.0 : 0.0 ) - G[ i * kVecs + j ] );
+
+				frob.Add( ( kDev / scale ) * ( kDev / scale ) );
+				row_sum.Add( kDev );
+
+				if( i == j )
+				{
+					report.fMaxDiagDev = std::max( report.fMaxDiagDev, kDev );
+					continue;
+				}
+
+				if( kDev > report.fMaxOffDiag )
+				{
+					report.fMaxOffDiag = kDev;
+					report.fMaxRow = i;
+					report.fMaxCol = j;
+				}
+
+				const double kNorms = std::sqrt( std::fabs( G[ i * kVecs + i ] ) ) * std::sqrt( std::fabs( G[ j * kVecs + j ] ) );
+				if( kNorms > 0.0 )
+					report.fMaxCosine = std::max( report.fMaxCosine, kDev / kNorms );
+			}
+			report.fMaxRowSum = std::max( report.fMaxRowSum, row_sum.Value() );
+		}
+
+		report.fFrobenius = scale * std::sqrt( frob.Value() );
+		return report;
+	}
+
+
+	inline OrthogonalityReport CheckOrthogonality( const std::vector< double > & G )
+	{
+		return CheckOrthogonality( G.data(), size_t( std::sqrt( double( G.size() ) ) + 0.5 ) );
+	}
+
+
+}	// end of namespace
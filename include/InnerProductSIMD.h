@@ -0,0 +1,671 @@
+#pragma once
+
+
+
+#include <cstddef>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "ErrorFreeTransforms.h"
+#include "MultiDouble.h"
+#include "ErrorBound.h"
+
+#if defined( __AVX512F__ ) || defined( __AVX__ )
+	#include <immintrin.h>
+#endif
+
+
+
+// SIMD kernels of the inner products.
+// The instruction set is chosen at compile time (see USE_NATIVE_ARCH
+// in CMakeLists.txt); without AVX a portable multi-lane version is used
+// which still breaks the single dependency chain of the serial algorithms.
+// The kernels take the data of type T, double or float. The float data
+// is loaded as float (half of the bytes) and widened in the registers,
+// so it is accumulated in double - where its products are exact.
+
+namespace InnerProducts
+{
+
+
+	// Merges kLanes partial Kahan sums, each given by its running sum theSum[ k ]
+	// and its correction c[ k ] (the value of a lane is theSum[ k ] - c[ k ]).
+	// Neumaier's version of the compensated summation is used here
+	// since the lanes can be of any magnitude.
+	inline double MergeKahanLanes( const double * theSum, const double * c, const size_t kLanes )
+	{
+		double s {}, comp {};
+
+		auto add = [ & s, & comp ] ( const double x )
+		{
+			const double t = s + x;
+			comp += std::fabs( s ) >= std::fabs( x ) ? ( s - t ) + x : ( x - t ) + s;
+			s = t;
+		};
+
+		for( size_t k = 0; k < kLanes; ++ k )
+		{
+			add( theSum[ k ] );
+			add( - c[ k ] );
+		}
+
+		return s + comp;
+	}
+
+
+
+	// The lanes of the SIMD kernels below, for their error bounds
+#if defined( __AVX512F__ )
+	constexpr size_t kKahanSIMDLanes { 32 }, kDot2SIMDLanes { 32 }, kDoubleDoubleSIMDLanes { 16 };
+#elif defined( __AVX__ ) && defined( __FMA__ )
+	constexpr size_t kKahanSIMDLanes { 16 }, kDot2SIMDLanes { 16 }, kDoubleDoubleSIMDLanes { 8 };
+#elif defined( __AVX__ )
+	constexpr size_t kKahanSIMDLanes { 16 }, kDot2SIMDLanes { 4 }, kDoubleDoubleSIMDLanes { 4 };
+#else
+	constexpr size_t kKahanSIMDLanes { 8 }, kDot2SIMDLanes { 4 }, kDoubleDoubleSIMDLanes { 4 };
+#endif
+
+
+	// True if the product of two T is exact in A, e.g. float * float in double
+	template < typename T, typename A = double >
+	constexpr bool kExactProduct { 2 * std::numeric_limits< T >::digits <= std::numeric_limits< A >::digits };
+
+
+	namespace Detail
+	{
+		// Loads the registers of doubles from the data of T, widening float
+	#if defined( __AVX512F__ )
+		inline __m512d Load512( const double * x ) { return _mm512_loadu_pd( x ); }
+		// (the zero-masked conversion, since GCC warns on the undefined source of _mm512_cvtps_pd)
+		inline __m512d Load512( const float * x ) { return _mm512_maskz_cvtps_pd( __mmask8( 0xFF ), _mm256_loadu_ps( x ) ); }
+	#endif
+	#if defined( __AVX__ )
+		inline __m256d Load256( const double * x ) { return _mm256_loadu_pd( x ); }
+		inline __m256d Load256( const float * x ) { return _mm256_cvtps_pd( _mm_loadu_ps( x ) ); }
+	#endif
+	}
+
+
+	namespace Detail
+	{
+		// The Kahan lanes of InnerProduct_KahanAlg_SIMD: adds the products
+		// v[ i ] * w[ i ] to the running sums lane_sum and the corrections lane_c
+		// of the kKahanSIMDLanes lanes (the tail goes to the lane 0) and, if kAbsSum,
+		// their | values | to lane_abs. So a sum can go on over several calls,
+		// e.g. over the blocks of a row (see CompensatedGEMV.h).
+		template < bool kAbsSum, typename T >
+		inline void KahanLanes_SIMD( const T * v, const T * w, const size_t kElems, double * lane_sum, double * lane_c, double * lane_abs )
+		{
+			size_t i {};
+
+		#if defined( __AVX512F__ )
+
+			constexpr size_t kRegs { 4 }, kWidth { 8 }, kLanes { kRegs * kWidth };
+
+			__m512d theSum[ kRegs ], c[ kRegs ], a_sum[ kRegs ];
+			for( size_t r = 0; r < kRegs; ++ r )
+			{
+				theSum[ r ] = _mm512_loadu_pd( lane_sum + r * kWidth );
+				c[ r ] = _mm512_loadu_pd( lane_c + r * kWidth );
+				if constexpr( kAbsSum )
+					a_sum[ r ] = _mm512_loadu_pd( lane_abs + r * kWidth );
+			}
+
+			for( ; i + kLanes <= kElems; i += kLanes )
+				for( size_t r = 0; r < kRegs; ++ r )
+				{
+					const __m512d h = _mm512_mul_pd( Load512( v + i + r * kWidth ), Load512( w + i + r * kWidth ) );
+					if constexpr( kAbsSum )
+						a_sum[ r ] = _mm512_add_pd( a_sum[ r ], _mm512_abs_pd( h ) );
+
+					const __m512d y = _mm512_sub_pd( h, c[ r ] );
+					const __m512d t = _mm512_add_pd( theSum[ r ], y );
+					c[ r ] = _mm512_sub_pd( _mm512_sub_pd( t, theSum[ r ] ), y );
+					theSum[ r ] = t;
+				}
+
+			for( size_t r = 0; r < kRegs; ++ r )
+			{
+				_mm512_storeu_pd( lane_sum + r * kWidth, theSum[ r ] );
+				_mm512_storeu_pd( lane_c + r * kWidth, c[ r ] );
+				if constexpr( kAbsSum )
+					_mm512_storeu_pd( lane_abs + r * kWidth, a_sum[ r ] );
+			}
+
+		#elif defined( __AVX__ )
+
+			constexpr size_t kRegs { 4 }, kWidth { 4 }, kLanes { kRegs * kWidth };
+
+			const __m256d kSignMask = _mm256_set1_pd( -0.0 );
+
+			__m256d theSum[ kRegs ], c[ kRegs ], a_sum[ kRegs ];
+			for( size_t r = 0; r < kRegs; ++ r )
+			{
+				theSum[ r ] = _mm256_loadu_pd( lane_sum + r * kWidth );
+				c[ r ] = _mm256_loadu_pd( lane_c + r * kWidth );
+				if constexpr( kAbsSum )
+					a_sum[ r ] = _mm256_loadu_pd( lane_abs + r * kWidth );
+			}
+
+			for( ; i + kLanes <= kElems; i += kLanes )
+				for( size_t r = 0; r < kRegs; ++ r )
+				{
+					const __m256d h = _mm256_mul_pd( Load256( v + i + r * kWidth ), Load256( w + i + r * kWidth ) );
+					if constexpr( kAbsSum )
+						a_sum[ r ] = _mm256_add_pd( a_sum[ r ], _mm256_andnot_pd( kSignMask, h ) );
+
+					const __m256d y = _mm256_sub_pd( h, c[ r ] );
+					const __m256d t = _mm256_add_pd( theSum[ r ], y );
+					c[ r ] = _mm256_sub_pd( _mm256_sub_pd( t, theSum[ r ] ), y );
+					theSum[ r ] = t;
+				}
+
+			for( size_t r = 0; r < kRegs; ++ r )
+			{
+				_mm256_storeu_pd( lane_sum + r * kWidth, theSum[ r ] );
+				_mm256_storeu_pd( lane_c + r * kWidth, c[ r ] );
+				if constexpr( kAbsSum )
+					_mm256_storeu_pd( lane_abs + r * kWidth, a_sum[ r ] );
+			}
+
+		#else
+
+			constexpr size_t kLanes { 8 };
+
+			// A local copy, since the lanes could alias the data
+			double s[ kLanes ], cr[ kLanes ], a[ kLanes ] {};
+			std::copy_n( lane_sum, kLanes, s );
+			std::copy_n( lane_c, kLanes, cr );
+			if constexpr( kAbsSum )
+				std::copy_n( lane_abs, kLanes, a );
+
+			for( ; i + kLanes <= kElems; i += kLanes )
+				for( size_t k = 0; k < kLanes; ++ k )
+				{
+					const double h = double( v[ i + k ] ) * double( w[ i + k ] );
+					if constexpr( kAbsSum )
+						a[ k ] += std::fabs( h );
+
+					const double y = h - cr[ k ];
+					const double t = s[ k ] + y;
+					cr[ k ] = ( t - s[ k ] ) - y;
+					s[ k ] = t;
+				}
+
+			std::copy_n( s, kLanes, lane_sum );
+			std::copy_n( cr, kLanes, lane_c );
+			if constexpr( kAbsSum )
+				std::copy_n( a, kLanes, lane_abs );
+
+		#endif
+
+			static_assert( kLanes == kKahanSIMDLanes );
+
+			// The tail goes to the lane 0
+			for( ; i < kElems; ++ i )
+			{
+				const double h = double( v[ i ] ) * double( w[ i ] );
+				if constexpr( kAbsSum )
+					lane_abs[ 0 ] += std::fabs( h );
+
+				const double y = h - lane_c[ 0 ];
+				const double t = lane_sum[ 0 ] + y;
+				lane_c[ 0 ] = ( t - lane_sum[ 0 ] ) - y;
+				lane_sum[ 0 ] = t;
+			}
+		}
+
+
+		// InnerProduct_KahanAlg_SIMD; if kAbsSum, then it also sums up
+		// | v[ i ] * w[ i ] | in its own lanes of the same loop
+		template < bool kAbsSum, typename T >
+		inline double KahanAlg_SIMD( const T * v, const T * w, const size_t kElems, double & abs_sum )
+		{
+			double lane_sum[ kKahanSIMDLanes ] {}, lane_c[ kKahanSIMDLanes ] {}, lane_abs[ kKahanSIMDLanes ] {};
+
+			KahanLanes_SIMD< kAbsSum >( v, w, kElems, lane_sum, lane_c, lane_abs );
+
+			if constexpr( kAbsSum )
+			{
+				abs_sum = 0.0;
+				for( size_t k = 0; k < kKahanSIMDLanes; ++ k )
+					abs_sum += lane_abs[ k ];
+			}
+
+			return MergeKahanLanes( lane_sum, lane_c, kKahanSIMDLanes );
+		}
+	}
+
+
+
+	///////////////////////////////////////////////////////////
+	// Multi-lane Kahan inner product
+	///////////////////////////////////////////////////////////
+	//
+	// INPUT:
+	//		v, w - pointers to the input data (of double or float)
+	//		kElems - number of elements to process
+	// OUTPUT:
+	//		the inner product of v and w
+	//
+	// REMARKS:
+	//		Each lane runs its own Kahan summation on every
+	//		kLanes-th product, so the lanes are independent and
+	//		fill the SIMD registers (32 lanes with AVX-512, 16 with AVX,
+	//		8 scalar ones otherwise). There is no volatile here
+	//		- without -ffast-math the compiler is not allowed to
+	//		simplify ( t - theSum ) - y anyway.
+	//		The lanes are merged with a compensated summation at the end.
+	//
+	template < typename T >
+	inline double InnerProduct_KahanAlg_SIMD( const T * v, const T * w, const size_t kElems )
+	{
+		double abs_sum {};
+		return Detail::KahanAlg_SIMD< false >( v, w, kElems, abs_sum );
+	}
+
+
+	// The same, which also returns the computed sum | v[ i ] * w[ i ] |
+	// (of kElems + kKahanSIMDLanes rounded terms, see AbsSumBound)
+	// from the same loop over the data
+	template < typename T >
+	inline double InnerProduct_KahanAlg_SIMD( const T * v, const T * w, const size_t kElems, double & abs_sum )
+	{
+		return Detail::KahanAlg_SIMD< true >( v, w, kElems, abs_sum );
+	}
+
+
+	// The same with the a-posteriori error bound, see KahanErrorBound
+	template < typename T >
+	inline InnerProductResult InnerProduct_KahanAlg_SIMD_Bounded( const T * v, const T * w, const size_t kElems )
+	{
+		double abs_sum {};
+		const double kValue = InnerProduct_KahanAlg_SIMD( v, w, kElems, abs_sum );
+		abs_sum = AbsSumBound( abs_sum, kElems + kKahanSIMDLanes );
+		return MakeInnerProductResult( kValue, abs_sum, KahanErrorBound( kElems, kKahanSIMDLanes, kValue, abs_sum ) );
+	}
+
+
+
+
+	namespace Detail
+	{
+		// InnerProduct_Dot2_SIMD_Partial; if kAbsSum, then it also sums up
+		// | v[ i ] * w[ i ] | in its own lanes of the same loop
+		template < bool kAbsSum, typename T >
+		inline CompensatedSum Dot2_SIMD( const T * v, const T * w, const size_t kElems, double & abs_sum )
+		{
+			size_t i {};
+
+		#if defined( __AVX512F__ )
+
+			constexpr size_t kRegs { 4 }, kWidth { 8 }, kLanes { kRegs * kWidth };
+
+			__m512d p[ kRegs ], s[ kRegs ], a_sum[ kRegs ];
+			for( size_t r = 0; r < kRegs; ++ r )
+				p[ r ] = s[ r ] = a_sum[ r ] = _mm512_setzero_pd();
+
+			for( ; i + kLanes <= kElems; i += kLanes )
+				for( size_t r = 0; r < kRegs; ++ r )
+				{
+					const __m512d a = Load512( v + i + r * kWidth );
+					const __m512d b = Load512( w + i + r * kWidth );
+					const __m512d h = _mm512_mul_pd( a, b );
+					if constexpr( kAbsSum )
+						a_sum[ r ] = _mm512_add_pd( a_sum[ r ], _mm512_abs_pd( h ) );
+
+					const __m512d h_err = kExactProduct< T > ? _mm512_setzero_pd() : _mm512_fmsub_pd( a, b, h );		// TwoProduct
+					const __m512d t = _mm512_add_pd( p[ r ], h );			// TwoSum
+					const __m512d z = _mm512_sub_pd( t, p[ r ] );
+					const __m512d t_err = _mm512_add_pd( _mm512_sub_pd( p[ r ], _mm512_sub_pd( t, z ) ), _mm512_sub_pd( h, z ) );
+					p[ r ] = t;
+					s[ r ] = _mm512_add_pd( s[ r ], _mm512_add_pd( t_err, h_err ) );
+				}
+
+			alignas( 64 ) double lane_p[ kLanes ], lane_s[ kLanes ], lane_abs[ kLanes ];
+			for( size_t r = 0; r < kRegs; ++ r )
+			{
+				_mm512_store_pd( lane_p + r * kWidth, p[ r ] );
+				_mm512_store_pd( lane_s + r * kWidth, s[ r ] );
+				_mm512_store_pd( lane_abs + r * kWidth, a_sum[ r ] );
+			}
+
+		#elif defined( __AVX__ ) && defined( __FMA__ )
+
+			constexpr size_t kRegs { 4 }, kWidth { 4 }, kLanes { kRegs * kWidth };
+
+			const __m256d kSignMask = _mm256_set1_pd( -0.0 );
+
+			__m256d p[ kRegs ], s[ kRegs ], a_sum[ kRegs ];
+			for( size_t r = 0; r < kRegs; ++ r )
+				p[ r ] = s[ r ] = a_sum[ r ] = _mm256_setzero_pd();
+
+			for( ; i + kLanes <= kElems; i += kLanes )
+				for( size_t r = 0; r < kRegs; ++ r )
+				{
+					const __m256d a = Load256( v + i + r * kWidth );
+					const __m256d b = Load256( w + i + r * kWidth );
+					const __m256d h = _mm256_mul_pd( a, b );
+					if constexpr( kAbsSum )
+						a_sum[ r ] = _mm256_add_pd( a_sum[ r ], _mm256_andnot_pd( kSignMask, h ) );
+
+					const __m256d h_err = kExactProduct< T > ? _mm256_setzero_pd() : _mm256_fmsub_pd( a, b, h );		// TwoProduct
+					const __m256d t = _mm256_add_pd( p[ r ], h );			// TwoSum
+					const __m256d z = _mm256_sub_pd( t, p[ r ] );
+					const __m256d t_err = _mm256_add_pd( _mm256_sub_pd( p[ r ], _mm256_sub_pd( t, z ) ), _mm256_sub_pd( h, z ) );
+					p[ r ] = t;
+					s[ r ] = _mm256_add_pd( s[ r ], _mm256_add_pd( t_err, h_err ) );
+				}
+
+			alignas( 32 ) double lane_p[ kLanes ], lane_s[ kLanes ], lane_abs[ kLanes ];
+			for( size_t r = 0; r < kRegs; ++ r )
+			{
+				_mm256_store_pd( lane_p + r * kWidth, p[ r ] );
+				_mm256_store_pd( lane_s + r * kWidth, s[ r ] );
+				_mm256_store_pd( lane_abs + r * kWidth, a_sum[ r ] );
+			}
+
+		#else
+
+			constexpr size_t kLanes { 4 };
+
+			double lane_p[ kLanes ] {}, lane_s[ kLanes ] {}, lane_abs[ kLanes ] {};
+
+			for( ; i + kLanes <= kElems; i += kLanes )
+				for( size_t k = 0; k < kLanes; ++ k )
+				{
+					double h {}, h_err {}, t_err {};
+					TwoProduct( double( v[ i + k ] ), double( w[ i + k ] ), h, h_err );
+					if constexpr( kAbsSum )
+						lane_abs[ k ] += std::fabs( h );
+
+					TwoSum( lane_p[ k ], h, lane_p[ k ], t_err );
+					lane_s[ k ] += t_err + h_err;
+				}
+
+		#endif
+
+			static_assert( kLanes == kDot2SIMDLanes );
+
+			// The tail goes to the lane 0
+			for( ; i < kElems; ++ i )
+			{
+				double h {}, h_err {}, t_err {};
+				TwoProduct( double( v[ i ] ), double( w[ i ] ), h, h_err );
+				if constexpr( kAbsSum )
+					lane_abs[ 0 ] += std::fabs( h );
+
+				TwoSum( lane_p[ 0 ], h, lane_p[ 0 ], t_err );
+				lane_s[ 0 ] += t_err + h_err;
+			}
+
+			if constexpr( kAbsSum )
+			{
+				abs_sum = 0.0;
+				for( size_t k = 0; k < kLanes; ++ k )
+					abs_sum += lane_abs[ k ];
+			}
+
+			CompensatedSum theSum;
+			for( size_t k = 0; k < kLanes; ++ k )
+				theSum.Add( CompensatedSum { lane_p[ k ], lane_s[ k ] } );
+
+			return theSum;
+		}
+	}
+
+
+
+	///////////////////////////////////////////////////////////
+	// Multi-lane Dot2 (Ogita, Rump, Oishi) inner product
+	///////////////////////////////////////////////////////////
+	//
+	// INPUT:
+	//		v, w - pointers to the input data (of double or float)
+	//		kElems - number of elements to process
+	// OUTPUT:
+	//		the inner product as an unevaluated sum fHi + fLo
+	//
+	// REMARKS:
+	//		Each lane keeps its own Dot2 pair ( p, s ): the rounding
+	//		error of a product is obtained with FMA, the one of
+	//		the addition with TwoSum, and both go to s.
+	//		The result is as accurate as if computed in twice
+	//		the working precision. The SIMD paths need FMA
+	//		(AVX-512 or AVX2 with FMA), otherwise std::fma is used
+	//		on 4 scalar lanes. The products of float data are exact
+	//		in double, so for it there is no TwoProduct in the SIMD
+	//		paths.
+	//
+	template < typename T >
+	inline CompensatedSum InnerProduct_Dot2_SIMD_Partial( const T * v, const T * w, const size_t kElems )
+	{
+		double abs_sum {};
+		return Detail::Dot2_SIMD< false >( v, w, kElems, abs_sum );
+	}
+
+
+	// The same, which also returns the computed sum | v[ i ] * w[ i ] |
+	// (of kElems + kDot2SIMDLanes rounded terms, see AbsSumBound)
+	// from the same loop over the data
+	template < typename T >
+	inline CompensatedSum InnerProduct_Dot2_SIMD_Partial( const T * v, const T * w, const size_t kElems, double & abs_sum )
+	{
+		return Detail::Dot2_SIMD< true >( v, w, kElems, abs_sum );
+	}
+
+
+	template < typename T >
+	inline double InnerProduct_Dot2_SIMD( const T * v, const T * w, const size_t kElems )
+	{
+		return InnerProduct_Dot2_SIMD_Partial( v, w, kElems ).Value();
+	}
+
+
+	// The same with the a-posteriori error bound, see Dot2ErrorBound
+	template < typename T >
+	inline InnerProductResult InnerProduct_Dot2_SIMD_Bounded( const T * v, const T * w, const size_t kElems )
+	{
+		double abs_sum {};
+		const double kValue = InnerProduct_Dot2_SIMD_Partial( v, w, kElems, abs_sum ).Value();
+		abs_sum = AbsSumBound( abs_sum, kElems + kDot2SIMDLanes );
+		return MakeInnerProductResult( kValue, abs_sum, Dot2ErrorBound( kElems, kDot2SIMDLanes, kValue, abs_sum ) );
+	}
+
+
+
+
+	namespace Detail
+	{
+		// InnerProduct_DoubleDouble_SIMD_Partial; if kAbsSum, then it also sums up
+		// | v[ i ] * w[ i ] | in its own lanes of the same loop
+		template < bool kAbsSum, typename T >
+		inline DoubleDouble DoubleDouble_SIMD( const T * v, const T * w, const size_t kElems, double & abs_sum )
+		{
+			size_t i {};
+
+		#if defined( __AVX512F__ ) || ( defined( __AVX__ ) && defined( __FMA__ ) )
+
+		#if defined( __AVX512F__ )
+			constexpr size_t kRegs { 2 }, kWidth { 8 };
+
+			using Reg = __m512d;
+			auto load = [] ( const T * x ) { return Load512( x ); };
+			auto store = [] ( double * x, Reg r ) { _mm512_store_pd( x, r ); };
+			auto zero = [] () { return _mm512_setzero_pd(); };
+			auto add = [] ( Reg x, Reg y ) { return _mm512_add_pd( x, y ); };
+			auto sub = [] ( Reg x, Reg y ) { return _mm512_sub_pd( x, y ); };
+			auto mul = [] ( Reg x, Reg y ) { return _mm512_mul_pd( x, y ); };
+			auto fmsub = [] ( Reg x, Reg y, Reg z ) { return _mm512_fmsub_pd( x, y, z ); };
+			auto abs = [] ( Reg x ) { return _mm512_abs_pd( x ); };
+		#else
+			constexpr size_t kRegs { 2 }, kWidth { 4 };
+
+			using Reg = __m256d;
+			auto load = [] ( const T * x ) { return Load256( x ); };
+			auto store = [] ( double * x, Reg r ) { _mm256_store_pd( x, r ); };
+			auto zero = [] () { return _mm256_setzero_pd(); };
+			auto add = [] ( Reg x, Reg y ) { return _mm256_add_pd( x, y ); };
+			auto sub = [] ( Reg x, Reg y ) { return _mm256_sub_pd( x, y ); };
+			auto mul = [] ( Reg x, Reg y ) { return _mm256_mul_pd( x, y ); };
+			auto fmsub = [] ( Reg x, Reg y, Reg z ) { return _mm256_fmsub_pd( x, y, z ); };
+			auto abs = [] ( Reg x ) { return _mm256_andnot_pd( _mm256_set1_pd( -0.0 ), x ); };
+		#endif
+
+			constexpr size_t kLanes { kRegs * kWidth };
+
+			auto two_sum = [ & ] ( Reg a, Reg b, Reg & s, Reg & e )
+			{
+				s = add( a, b );
+				const Reg z = sub( s, a );
+				e = add( sub( a, sub( s, z ) ), sub( b, z ) );
+			};
+
+			auto fast_two_sum = [ & ] ( Reg a, Reg b, Reg & s, Reg & e )
+			{
+				s = add( a, b );
+				e = sub( b, sub( s, a ) );
+			};
+
+			Reg hi[ kRegs ], lo[ kRegs ], a_sum[ kRegs ];
+			for( size_t r = 0; r < kRegs; ++ r )
+				hi[ r ] = lo[ r ] = a_sum[ r ] = zero();
+
+			for( ; i + kLanes <= kElems; i += kLanes )
+				for( size_t r = 0; r < kRegs; ++ r )
+				{
+					const Reg a = load( v + i + r * kWidth );
+					const Reg b = load( w + i + r * kWidth );
+					const Reg h = mul( a, b );
+					const Reg h_err = fmsub( a, b, h );		// TwoProduct
+					if constexpr( kAbsSum )
+						a_sum[ r ] = add( a_sum[ r ], abs( h ) );
+
+					Reg s, e, t, f;							// AccurateDWPlusDW
+					two_sum( hi[ r ], h, s, e );
+					two_sum( lo[ r ], h_err, t, f );
+					e = add( e, t );
+					fast_two_sum( s, e, s, e );
+					e = add( e, f );
+					fast_two_sum( s, e, hi[ r ], lo[ r ] );
+				}
+
+			alignas( 64 ) double lane_hi[ kLanes ], lane_lo[ kLanes ], lane_abs[ kLanes ];
+			for( size_t r = 0; r < kRegs; ++ r )
+			{
+				store( lane_hi + r * kWidth, hi[ r ] );
+				store( lane_lo + r * kWidth, lo[ r ] );
+				store( lane_abs + r * kWidth, a_sum[ r ] );
+			}
+
+		#else
+
+			constexpr size_t kLanes { 4 };
+
+			double lane_hi[ kLanes ] {}, lane_lo[ kLanes ] {}, lane_abs[ kLanes ] {};
+
+			for( ; i + kLanes <= kElems; i += kLanes )
+				for( size_t k = 0; k < kLanes; ++ k )
+				{
+					const DoubleDouble kProd { DoubleDouble::Product( double( v[ i + k ] ), double( w[ i + k ] ) ) };
+					if constexpr( kAbsSum )
+						lane_abs[ k ] += std::fabs( kProd.fHi );
+
+					DoubleDouble dd { lane_hi[ k ], lane_lo[ k ] };
+					dd += kProd;
+					lane_hi[ k ] = dd.fHi;
+					lane_lo[ k ] = dd.fLo;
+				}
+
+		#endif
+
+			static_assert( kLanes == kDoubleDoubleSIMDLanes );
+
+			DoubleDouble theSum;
+			for( size_t k = 0; k < kLanes; ++ k )
+				theSum += DoubleDouble { lane_hi[ k ], lane_lo[ k ] };
+
+			// The tail
+			for( ; i < kElems; ++ i )
+			{
+				const DoubleDouble kProd { DoubleDouble::Product( double( v[ i ] ), double( w[ i ] ) ) };
+				if constexpr( kAbsSum )
+					lane_abs[ 0 ] += std::fabs( kProd.fHi );
+
+				theSum += kProd;
+			}
+
+			if constexpr( kAbsSum )
+			{
+				abs_sum = 0.0;
+				for( size_t k = 0; k < kLanes; ++ k )
+					abs_sum += lane_abs[ k ];
+			}
+
+			return theSum;
+		}
+	}
+
+
+
+	///////////////////////////////////////////////////////////
+	// Multi-lane double-double inner product
+	///////////////////////////////////////////////////////////
+	//
+	// INPUT:
+	//		v, w - pointers to the input data (of double or float)
+	//		kElems - number of elements to process
+	// OUTPUT:
+	//		the inner product as a double-double
+	//
+	// REMARKS:
+	//		Each lane keeps its own double-double ( hi, lo ) and adds
+	//		the exact product ( h, h_err ) of TwoProduct with the
+	//		accurate double-double addition of DoubleDouble.
+	//		Contrary to Dot2, the sum is renormalized on each
+	//		step, so each addition errs by u^2 rather than by u of
+	//		the partial sum. The error still grows with the number
+	//		of elements, but linearly - it is at most
+	//		4 ( n + lanes ) u^2 sum | v[ i ] w[ i ] | (see
+	//		DoubleDoubleErrorBound) against the gamma_n^2 ~ n^2 u^2
+	//		of Dot2. The SIMD paths need FMA, otherwise std::fma
+	//		is used on 4 scalar lanes.
+	//
+	template < typename T >
+	inline DoubleDouble InnerProduct_DoubleDouble_SIMD_Partial( const T * v, const T * w, const size_t kElems )
+	{
+		double abs_sum {};
+		return Detail::DoubleDouble_SIMD< false >( v, w, kElems, abs_sum );
+	}
+
+
+	// The same, which also returns the computed sum | v[ i ] * w[ i ] |
+	// (of kElems + kDoubleDoubleSIMDLanes rounded terms, see AbsSumBound)
+	// from the same loop over the data
+	template < typename T >
+	inline DoubleDouble InnerProduct_DoubleDouble_SIMD_Partial( const T * v, const T * w, const size_t kElems, double & abs_sum )
+	{
+		return Detail::DoubleDouble_SIMD< true >( v, w, kElems, abs_sum );
+	}
+
+
+	template < typename T >
+	inline double InnerProduct_DoubleDouble_SIMD( const T * v, const T * w, const size_t kElems )
+	{
+		return InnerProduct_DoubleDouble_SIMD_Partial( v, w, kElems ).ToDouble();
+	}
+
+
+	// The same with the a-posteriori error bound, see DoubleDoubleErrorBound
+	template < typename T >
+	inline InnerProductResult InnerProduct_DoubleDouble_SIMD_Bounded( const T * v, const T * w, const size_t kElems )
+	{
+		double abs_sum {};
+		const double kValue = InnerProduct_DoubleDouble_SIMD_Partial( v, w, kElems, abs_sum ).ToDouble();
+		abs_sum = AbsSumBound( abs_sum, kElems + kDoubleDoubleSIMDLanes );
+		return MakeInnerProductResult( kValue, abs_sum, DoubleDoubleErrorBound( kElems + kDoubleDoubleSIMDLanes, kValue, abs_sum ) );
+	}
+
+
+}	// end of namespace
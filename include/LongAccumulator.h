@@ -0,0 +1,289 @@
+#pragma once
+
+
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+#include "ErrorFreeTransforms.h"
+
+
+
+namespace InnerProducts
+{
+
+
+	// A Kulisch-style long fixed-point accumulator that covers the whole
+	// range of the exact products of two doubles, i.e. from 2^-2148 up
+	// to 2^2048, with some headroom for the carries. Thus all sums of products
+	// are exact and the rounding takes place only once, in GetSum().
+	//
+	// The number is kept in kLimbs signed 64-bit limbs, each carrying
+	// a 32-bit digit (limb k has the weight 2^( 32 k - kBitOffset )).
+	// The upper 32 bits of a limb absorb the carries, so these are not
+	// propagated on each addition but only once per kMaxDeferredAdds
+	// additions (carry-save deferral).
+	//
+	// Each product v * w is split with TwoProduct into h + r, both are added.
+	// Products that would underflow or overflow in TwoProduct are
+	// scaled by powers of two first, so these are also exact.
+	//
+	// Instances are independent, so each thread can have its own one;
+	// these are then merged exactly with Merge().
+	class LongAccumulator
+	{
+		public:
+
+			static constexpr int		kDigitBits { 32 };
+			static constexpr int		kBitOffset { 2304 };		// the bit 0 has the weight 2^-kBitOffset
+			static constexpr int		kLimbs { 140 };				// 4480 bits in total
+
+			static constexpr uint64_t	kMaxDeferredAdds { uint64_t( 1 ) << 30 };
+
+		private:
+
+			int64_t		fLimb[ kLimbs ];
+
+			uint64_t	fDeferredAdds {};		// additions since the last carry propagation
+
+			double		fNonFinite {};			// sum of the inf and NaN contributions, if any
+
+			static constexpr uint64_t	kDigitMask { ( uint64_t( 1 ) << kDigitBits ) - 1 };
+
+			static constexpr int		kScaleExp { 600 };		// used to scale the too small or too large products
+
+		public:
+
+			LongAccumulator( void ) { Reset(); }
+
+			void Reset( void )
+			{
+				std::memset( fLimb, 0, sizeof( fLimb ) );
+				fDeferredAdds = 0;
+				fNonFinite = 0.0;
+			}
+
+		public:
+
+			// Adds a single number
+			void AddNumber( const double x )
+			{
+				if( ! std::isfinite( x ) )
+				{
+					fNonFinite += x;
+					return;
+				}
+
+				AddScaled( x, 0 );
+				CountAdds( 1 );
+			}
+
+			// Adds the exact product a * b
+			void AddProduct( const double a, const double b )
+			{
+				double h {}, r {};
+				TwoProduct( a, b, h, r );
+
+				const double kAbsH = std::fabs( h );
+
+				if( kAbsH >= 0x1p-968 && kAbsH < 0x1p1000 )
+				{
+					// The most common case - TwoProduct is exact
+					AddScaled( h, 0 );
+					AddScaled( r, 0 );
+				}
+				else if( ! std::isfinite( a ) || ! std::isfinite( b ) )
+				{
+					fNonFinite += h;
+					return;
+				}
+				else if( kAbsH < 0x1p-968 )
+				{
+					// Would lose bits in the underflow, so scale up both
+					TwoProduct( std::ldexp( a, kScaleExp ), std::ldexp( b, kScaleExp ), h, r );
+					AddScaled( h, - 2 * kScaleExp );
+					AddScaled( r, - 2 * kScaleExp );
+				}
+				else
+				{
+					// Would overflow, so scale down both
+					TwoProduct( std::ldexp( a, - kScaleExp ), std::ldexp( b, - kScaleExp ), h, r );
+					AddScaled( h, 2 * kScaleExp );
+					AddScaled( r, 2 * kScaleExp );
+				}
+
+				CountAdds( 2 );
+			}
+
+			// Adds the exact inner product of v and w
+			void AddProducts( const double * v, const double * w, const size_t kElems )
+			{
+				for( size_t i = 0; i < kElems; ++ i )
+					AddProduct( v[ i ], w[ i ] );
+			}
+
+			// The same, which also adds the computed | v[ i ] * w[ i ] |
+			// to abs_sum in the same loop over the data
+			void AddProducts( const double * v, const double * w, const size_t kElems, double & abs_sum )
+			{
+				for( size_t i = 0; i < kElems; ++ i )
+				{
+					abs_sum += std::fabs( v[ i ] * w[ i ] );
+					AddProduct( v[ i ], w[ i ] );
+				}
+			}
+
+			// Adds the other accumulator (exactly)
+			void Merge( const LongAccumulator & other )
+			{
+				if( fDeferredAdds + other.fDeferredAdds >= kMaxDeferredAdds )
+					Normalize();
+
+				for( int k = 0; k < kLimbs; ++ k )
+					fLimb[ k ] += other.fLimb[ k ];
+
+				fDeferredAdds += other.fDeferredAdds;
+				fNonFinite += other.fNonFinite;
+
+				CountAdds( 0 );
+			}
+
+			///////////////////////////////////////////////////////////
+			// Returns the accumulated value correctly rounded to double
+			///////////////////////////////////////////////////////////
+			//
+			// REMARKS:
+			//		The rounding is to the nearest, ties to even.
+			//		The accumulator is normalized but its value
+			//		does not change, so the summation can go on.
+			//
+			double GetSum( void )
+			{
+				if( fNonFinite != 0.0 || std::isnan( fNonFinite ) )
+					return fNonFinite;
+
+				Normalize();
+
+				// After the normalization all limbs but the last one are in [0,2^32),
+				// so the sign of the value is the sign of the last limb
+				if( fLimb[ kLimbs - 1 ] < 0 )
+				{
+					LongAccumulator neg;
+					for( int k = 0; k < kLimbs; ++ k )
+						neg.fLimb[ k ] = - fLimb[ k ];
+					return - neg.GetSum();
+				}
+
+				// Find the most significant bit
+				int top = kLimbs - 1;
+				while( top >= 0 && fLimb[ top ] == 0 )
+					-- top;
+
+				if( top < 0 )
+					return 0.0;
+
+				int msb = top * kDigitBits;
+				for( uint64_t d = uint64_t( fLimb[ top ] ) >> 1; d != 0; d >>= 1 )
+					++ msb;
+
+				// Take at most 53 bits, but not below 2^-1074 (subnormals)
+				const int kLowest = std::max( msb - 52, kBitOffset - 1074 );
+
+				uint64_t mant {};
+				for( int b = msb; b >= kLowest; -- b )
+					mant = ( mant << 1 ) | GetBit( b );
+
+				// Round to nearest, ties to even
+				if( kLowest > 0 && GetBit( kLowest - 1 ) && ( ( mant & 1 ) || AnyBitBelow( kLowest - 1 ) ) )
+					++ mant;
+
+				return std::ldexp( double( mant ), kLowest - kBitOffset );		// the overflow to inf is handled here
+			}
+
+		private:
+
+			// Adds x * 2^extra_exp
+			void AddScaled( const double x, const int extra_exp )
+			{
+				if( x == 0.0 )
+					return;
+
+				uint64_t bits {};
+				std::memcpy( & bits, & x, sizeof( bits ) );
+
+				const int		kExp = int( ( bits >> 52 ) & 0x7FF );
+				const uint64_t	kMant = ( bits & ( ( uint64_t( 1 ) << 52 ) - 1 ) ) | ( kExp > 0 ? uint64_t( 1 ) << 52 : 0 );
+
+				// The position of the lowest bit of the mantissa
+				const int kPos = std::max( kExp, 1 ) - 1075 + extra_exp + kBitOffset;
+				assert( kPos >= 0 && kPos / kDigitBits + 2 < kLimbs );
+
+				const int kLimb = kPos / kDigitBits;
+				const int kShift = kPos % kDigitBits;
+
+				// The 53-bit mantissa shifted by kShift spans over three digits
+				const uint64_t kRest = kMant >> ( kDigitBits - kShift );
+
+				const int64_t d0 = int64_t( ( kMant << kShift ) & kDigitMask );
+				const int64_t d1 = int64_t( kRest & kDigitMask );
+				const int64_t d2 = int64_t( kRest >> kDigitBits );
+
+				if( bits >> 63 )
+				{
+					fLimb[ kLimb ] -= d0;
+					fLimb[ kLimb + 1 ] -= d1;
+					fLimb[ kLimb + 2 ] -= d2;
+				}
+				else
+				{
+					fLimb[ kLimb ] += d0;
+					fLimb[ kLimb + 1 ] += d1;
+					fLimb[ kLimb + 2 ] += d2;
+				}
+			}
+
+			void CountAdds( const uint64_t n )
+			{
+				fDeferredAdds += n;
+				if( fDeferredAdds >= kMaxDeferredAdds )
+					Normalize();
+			}
+
+			// Propagates the carries, so each limb but the last one gets into [0,2^32)
+			void Normalize( void )
+			{
+				for( int k = 0; k < kLimbs - 1; ++ k )
+				{
+					const int64_t carry = fLimb[ k ] >> kDigitBits;		// arithmetic shift, i.e. floor
+					fLimb[ k ] -= carry * ( int64_t( 1 ) << kDigitBits );
+					fLimb[ k + 1 ] += carry;
+				}
+
+				fDeferredAdds = 0;
+			}
+
+			uint64_t GetBit( const int b ) const
+			{
+				return ( uint64_t( fLimb[ b / kDigitBits ] ) >> ( b % kDigitBits ) ) & 1;
+			}
+
+			// True if any bit below the bit b is set
+			bool AnyBitBelow( const int b ) const
+			{
+				const int kLimb = b / kDigitBits;
+				if( ( uint64_t( fLimb[ kLimb ] ) & ( ( uint64_t( 1 ) << ( b % kDigitBits ) ) - 1 ) ) != 0 )
+					return true;
+
+				for( int k = 0; k < kLimb; ++ k )
+					if( fLimb[ k ] != 0 )
+						return true;
+
+				return false;
+			}
+	};
+
+
+}	// end of namespace
@@ -0,0 +1,250 @@
+#pragma once
+
+
+
+#include <cstddef>
+#include <cmath>
+
+#include "ErrorFreeTransforms.h"
+
+
+
+// The double-double (106 bits of the mantissa) and the quad-double
+// (212 bits) numbers, i.e. the unevaluated sums of 2 or 4 doubles,
+// built on TwoSum and TwoProduct. These are a fast alternative to
+// the ttmath numbers of PrecLongComp when 106 or 212 bits are enough:
+// all of it runs on the hardware doubles, with no memory allocation.
+//
+// As ErrorFreeTransforms.h, this must not be compiled with -ffast-math.
+
+namespace InnerProducts
+{
+
+
+	// fHi + fLo, with |fLo| <= ulp( fHi ) / 2
+	struct DoubleDouble
+	{
+		double	fHi {};
+		double	fLo {};
+
+		DoubleDouble( void ) = default;
+		DoubleDouble( const double x ) : fHi( x ) {}
+		DoubleDouble( const double hi, const double lo ) : fHi( hi ), fLo( lo ) {}
+
+		// The exact product of two doubles
+		static DoubleDouble Product( const double a, const double b )
+		{
+			DoubleDouble r;
+			TwoProduct( a, b, r.fHi, r.fLo );
+			return r;
+		}
+
+		// Adds a double (Joldes, Muller, Popescu, DWPlusFP),
+		// the relative error of at most 2 u^2
+		DoubleDouble & operator += ( const double b )
+		{
+			double s {}, e {};
+			TwoSum( fHi, b, s, e );
+			e += fLo;
+			FastTwoSum( s, e, fHi, fLo );
+			return * this;
+		}
+
+		// The accurate addition (Joldes, Muller, Popescu, AccurateDWPlusDW),
+		// i.e. with the relative error of at most 3 u^2 even if the
+		// operands cancel out
+		DoubleDouble & operator += ( const DoubleDouble & b )
+		{
+			double s {}, e {}, t {}, f {};
+			TwoSum( fHi, b.fHi, s, e );
+			TwoSum( fLo, b.fLo, t, f );
+			e += t;
+			FastTwoSum( s, e, s, e );
+			e += f;
+			FastTwoSum( s, e, fHi, fLo );
+			return * this;
+		}
+
+		// DWTimesDW, the relative error of at most 5 u^2
+		DoubleDouble & operator *= ( const DoubleDouble & b )
+		{
+			double p {}, e {};
+			TwoProduct( fHi, b.fHi, p, e );
+			e += fHi * b.fLo + fLo * b.fHi;
+			FastTwoSum( p, e, fHi, fLo );
+			return * this;
+		}
+
+		DoubleDouble operator - ( void ) const { return { - fHi, - fLo }; }
+
+		DoubleDouble & operator -= ( const DoubleDouble & b ) { return * this += - b; }
+
+		double ToDouble( void ) const { return fHi + fLo; }
+	};
+
+
+	inline DoubleDouble operator + ( DoubleDouble a, const DoubleDouble & b ) { return a += b; }
+	inline DoubleDouble operator - ( DoubleDouble a, const DoubleDouble & b ) { return a -= b; }
+	inline DoubleDouble operator * ( DoubleDouble a, const DoubleDouble & b ) { return a *= b; }
+
+
+
+	// fX[ 0 ] + fX[ 1 ] + fX[ 2 ] + fX[ 3 ], the components are
+	// non-overlapping and in the decreasing order of magnitude
+	struct QuadDouble
+	{
+		double	fX[ 4 ] {};
+
+		QuadDouble( void ) = default;
+		QuadDouble( const double x ) : fX { x, 0.0, 0.0, 0.0 } {}
+
+		// Adds a double. It goes down the components with TwoSum (as in
+		// the qd library of Hida, Li and Bailey), then the 5 terms are
+		// renormalized to 4.
+		QuadDouble & operator += ( double b )
+		{
+			double c[ 5 ] {};
+			for( size_t k = 0; k < 4; ++ k )
+				TwoSum( fX[ k ], b, c[ k ], b );
+			c[ 4 ] = b;
+
+			Renormalize( c );
+			return * this;
+		}
+
+		// Adds the components of b one by one, from the largest
+		QuadDouble & operator += ( const QuadDouble & b )
+		{
+			for( size_t k = 0; k < 4; ++ k )
+				if( b.fX[ k ] != 0.0 )
+					* this += b.fX[ k ];
+			return * this;
+		}
+
+		// Adds the exact product a * b
+		QuadDouble & AddProduct( const double a, const double b )
+		{
+			double h {}, h_err {};
+			TwoProduct( a, b, h, h_err );
+			* this += h;
+			if( h_err != 0.0 )
+				* this += h_err;
+			return * this;
+		}
+
+		QuadDouble operator - ( void ) const { QuadDouble r; for( size_t k = 0; k < 4; ++ k ) r.fX[ k ] = - fX[ k ]; return r; }
+
+		double ToDouble( void ) const { return ( ( fX[ 3 ] + fX[ 2 ] ) + fX[ 1 ] ) + fX[ 0 ]; }
+
+		DoubleDouble ToDoubleDouble( void ) const { DoubleDouble r { fX[ 0 ], fX[ 1 ] }; r += DoubleDouble( fX[ 2 ], fX[ 3 ] ); return r; }
+
+	private:
+
+		// 5 terms of any magnitudes to 4 non-overlapping components.
+		// The bottom-up pass leaves the sum in t[ 0 ] and the errors
+		// below it, the top-down one then drops the zero errors.
+		// TwoSum is used in place of the FastTwoSum of the qd library,
+		// since the terms need not be ordered after a cancellation.
+		void Renormalize( const double c[ 5 ] )
+		{
+			double t[ 5 ] {};
+			double s { c[ 4 ] };
+			for( size_t k = 4; k -- > 0; )
+				TwoSum( c[ k ], s, s, t[ k + 1 ] );
+			t[ 0 ] = s;
+
+			size_t n {};
+			s = t[ 0 ];
+			for( size_t k = 1; k < 5; ++ k )
+			{
+				double e {};
+				TwoSum( s, t[ k ], s, e );
+				if( e == 0.0 )
+					continue;
+
+				if( n < 3 )
+				{
+					fX[ n ++ ] = s;
+					s = e;
+				}
+				else
+				{
+					s += e;			// below 4 doubles
+				}
+			}
+
+			fX[ n ++ ] = s;
+			for( ; n < 4; ++ n )
+				fX[ n ] = 0.0;
+		}
+	};
+
+
+	inline QuadDouble operator + ( QuadDouble a, const QuadDouble & b ) { return a += b; }
+
+
+
+	///////////////////////////////////////////////////////////
+	// Double-double and quad-double inner products
+	///////////////////////////////////////////////////////////
+	//
+	// INPUT:
+	//		v, w - pointers to the input data
+	//		kElems - number of elements to process
+	// OUTPUT:
+	//		the inner product with 106 (or 212) bits of precision
+	//
+	// REMARKS:
+	//		Each product goes to the accumulator exactly,
+	//		as the double-double of TwoProduct. See
+	//		InnerProduct_DoubleDouble_SIMD_Partial for the
+	//		multi-lane version.
+	//
+	inline DoubleDouble InnerProduct_DoubleDouble( const double * v, const double * w, const size_t kElems )
+	{
+		DoubleDouble	theSum;
+		for( size_t i = 0; i < kElems; ++ i )
+			theSum += DoubleDouble::Product( v[ i ], w[ i ] );
+		return theSum;
+	}
+
+
+	inline QuadDouble InnerProduct_QuadDouble( const double * v, const double * w, const size_t kElems )
+	{
+		QuadDouble		theSum;
+		for( size_t i = 0; i < kElems; ++ i )
+			theSum.AddProduct( v[ i ], w[ i ] );
+		return theSum;
+	}
+
+
+	// The same, but these also return the computed sum | v[ i ] * w[ i ] |
+	// (of kElems rounded terms) from the same loop over the data
+	inline DoubleDouble InnerProduct_DoubleDouble( const double * v, const double * w, const size_t kElems, double & abs_sum )
+	{
+		DoubleDouble	theSum;
+		abs_sum = 0.0;
+		for( size_t i = 0; i < kElems; ++ i )
+		{
+			const DoubleDouble kProd { DoubleDouble::Product( v[ i ], w[ i ] ) };
+			abs_sum += std::fabs( kProd.fHi );
+			theSum += kProd;
+		}
+		return theSum;
+	}
+
+
+	inline QuadDouble InnerProduct_QuadDouble( const double * v, const double * w, const size_t kElems, double & abs_sum )
+	{
+		QuadDouble		theSum;
+		abs_sum = 0.0;
+		for( size_t i = 0; i < kElems; ++ i )
+		{
+			abs_sum += std::fabs( v[ i ] * w[ i ] );
+			theSum.AddProduct( v[ i ], w[ i ] );
+		}
+		return theSum;
+	}
+
+
+}	// end of namespace
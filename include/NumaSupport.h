@@ -0,0 +1,426 @@
+#pragma once
+
+
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <future>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#if defined( _WIN32 )
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <unistd.h>
+#endif
+
+#if defined( __linux__ )
+	#include <sys/syscall.h>
+#endif
+
+#include "ThreadPool.h"
+#include "DataView.h"
+
+
+
+// NUMA support for the large-vector runs: the data is first touched by the
+// worker that will process it (so its pages land on that worker's node) and
+// moved for another pool, the workers can be pinned node by node, and the
+// page placement and the node counters can be read back. All of it uses sysfs and plain system
+// calls (no libnuma); off Linux the machine is seen as one node.
+
+namespace InnerProducts
+{
+
+
+	// The logical CPUs of each NUMA node
+	struct NumaTopology
+	{
+		std::vector< std::vector< unsigned > >	fNodeCpus;
+
+		size_t Nodes( void ) const { return fNodeCpus.size(); }
+
+		// The node of a CPU, or -1
+		int NodeOf( const unsigned cpu ) const
+		{
+			for( size_t n = 0; n < fNodeCpus.size(); ++ n )
+				if( std::find( fNodeCpus[ n ].begin(), fNodeCpus[ n ].end(), cpu ) != fNodeCpus[ n ].end() )
+					return int( n );
+			return -1;
+		}
+	};
+
+
+	namespace Detail
+	{
+		// Parses a sysfs CPU list, e.g. "0-7,16-23"
+		inline std::vector< unsigned > ParseCpuList( const std::string & s )
+		{
+			std::vector< unsigned >		cpus;
+			std::istringstream			iss( s );
+			for( std::string range; std::getline( iss, range, ',' ); )
+			{
+				std::istringstream	r( range );
+				unsigned			from {}, to {};
+				char				dash {};
+				if( ! ( r >> from ) )
+					continue;
+				if( ! ( r >> dash >> to ) )
+					to = from;
+				for( unsigned c = from; c <= to; ++ c )
+					cpus.push_back( c );
+			}
+			return cpus;
+		}
+	}
+
+
+	// Reads the nodes from /sys/devices/system/node; if there are none,
+	// then all of the CPUs make one node.
+	inline NumaTopology GetNumaTopology( void )
+	{
+		NumaTopology	topo;
+
+		for( int n = 0; ; ++ n )
+		{
+			std::ifstream	file( "/sys/devices/system/node/node" + std::to_string( n ) + "/cpulist" );
+			std::string		line;
+			if( ! std::getline( file, line ) )
+				break;
+			topo.fNodeCpus.push_back( Detail::ParseCpuList( line ) );
+		}
+
+		if( topo.fNodeCpus.empty() )
+		{
+			topo.fNodeCpus.emplace_back();
+			for( unsigned c = 0; c < std::max( 1u, std::thread::hardware_concurrency() ); ++ c )
+				topo.fNodeCpus[ 0 ].push_back( c );
+		}
+
+		return topo;
+	}
+
+
+	// The worker that owns the element i of n - the data is split into
+	// kWorkers equal blocks, the same way for the first touch and for
+	// the chunks of ChunkedPartials when the pool is pinned
+	inline size_t BlockOwner( const size_t i, const size_t n, const size_t kWorkers )
+	{
+		return n > 0 ? i * kWorkers / n : 0;
+	}
+
+
+	///////////////////////////////////////////////////////////
+	// Pins the workers of the pool, node by node
+	///////////////////////////////////////////////////////////
+	//
+	// INPUT:
+	//		pool - the workers to pin
+	//		topo - the nodes and their CPUs
+	// OUTPUT:
+	//		the node of each worker (empty if pinning failed)
+	//
+	// REMARKS:
+	//		The CPUs are ordered node by node and spread evenly
+	//		over the workers, so the consecutive workers - which own
+	//		the consecutive blocks of the data - share a node.
+	//
+	inline std::vector< int > PinThreadPool( ThreadPool & pool, const NumaTopology & topo )
+	{
+		std::vector< unsigned >		cpus;
+		for( const auto & node : topo.fNodeCpus )
+			cpus.insert( cpus.end(), node.begin(), node.end() );
+
+		std::vector< int >	worker_nodes;
+		if( cpus.empty() )
+			return worker_nodes;
+
+		for( size_t w = 0; w < pool.size(); ++ w )
+		{
+			const unsigned kCpu = cpus[ w * cpus.size() / pool.size() % cpus.size() ];
+			if( ! pool.PinWorker( w, kCpu ) )
+				return {};
+			worker_nodes.push_back( topo.NodeOf( kCpu ) );
+		}
+
+		return worker_nodes;
+	}
+
+
+
+	// An array of doubles whose pages are placed by the first touch:
+	// the memory is reserved but not touched on allocation, then each
+	// worker of the pool writes its own block (see BlockOwner).
+	class NumaBuffer
+	{
+		private:
+
+			double *	fData {};
+			size_t		fSize {};
+			size_t		fBytes {};
+
+			void Free( void )
+			{
+				if( fData == nullptr )
+					return;
+			#if defined( _WIN32 )
+				VirtualFree( fData, 0, MEM_RELEASE );
+			#else
+				munmap( fData, fBytes );
+			#endif
+				fData = nullptr;
+				fSize = fBytes = 0;
+			}
+
+			// Runs fun( from, to ) on the block of each worker of the pool,
+			// on that worker (SubmitTo)
+			template < typename F >
+			static void ForEachBlock( const size_t n, F fun )
+			{
+				ThreadPool &	pool = GetThreadPool();
+
+				const size_t kWorkers = pool.size();
+
+				std::vector< std::future< void > >	blocks;
+				for( size_t w = 0; w < kWorkers; ++ w )
+				{
+					// The first i with BlockOwner( i ) == w
+					const size_t kFrom = ( n * w + kWorkers - 1 ) / kWorkers;
+					const size_t kTo = ( n * ( w + 1 ) + kWorkers - 1 ) / kWorkers;
+					if( kFrom < kTo )
+						blocks.push_back( pool.SubmitTo( w, [ & fun, kFrom, kTo ] () { fun( kFrom, kTo ); } ) );
+				}
+				for( auto & b : blocks )
+					pool.Get( b );
+			}
+
+		public:
+
+			NumaBuffer( void ) = default;
+			~NumaBuffer() { Free(); }
+
+			NumaBuffer( const NumaBuffer & ) = delete;
+			NumaBuffer & operator = ( const NumaBuffer & ) = delete;
+
+			///////////////////////////////////////////////////////////
+			// Allocates n zeros in fresh pages, touched in parallel
+			///////////////////////////////////////////////////////////
+			//
+			// INPUT:
+			//		n - number of elements
+			// OUTPUT:
+			//		false if the memory cannot be allocated
+			//
+			// REMARKS:
+			//		The block of the worker w is first written by w
+			//		(SubmitTo), so with a pinned pool the pages of each
+			//		block end up on the node of its worker. The data
+			//		can be then generated in place, see data().
+			//
+			bool Allocate( const size_t n )
+			{
+				Free();
+
+				if( n == 0 )
+					return true;
+
+				fBytes = n * sizeof( double );
+
+			#if defined( _WIN32 )
+				void * mem = VirtualAlloc( nullptr, fBytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE );
+				if( mem == nullptr )
+					return false;
+			#else
+				void * mem = mmap( nullptr, fBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+				if( mem == MAP_FAILED )
+					return false;
+			#endif
+
+				fData = static_cast< double * >( mem );
+				fSize = n;
+
+				ForEachBlock( fSize, [ this ] ( size_t from, size_t to ) { std::fill( fData + from, fData + to, 0.0 ); } );
+
+				return true;
+			}
+
+			// Copies src into fresh pages, in parallel, as in Allocate
+			bool Assign( const DataView & src )
+			{
+				if( ! Allocate( src.size() ) )
+					return false;
+
+				ForEachBlock( fSize, [ this, & src ] ( size_t from, size_t to ) { std::memcpy( fData + from, src.data() + from, ( to - from ) * sizeof( double ) ); } );
+
+				return true;
+			}
+
+			///////////////////////////////////////////////////////////
+			// Moves the pages to the nodes of their workers
+			///////////////////////////////////////////////////////////
+			//
+			// INPUT:
+			//		worker_nodes - the node of each worker (of PinThreadPool)
+			// OUTPUT:
+			//		false if the pages cannot be moved
+			//
+			// REMARKS:
+			//		For a pool other than the one of Allocate (e.g. of
+			//		the next thread count) - the kernel moves only the
+			//		pages which are not on their node yet, with no copy
+			//		of the whole buffer. The pages of the workers with
+			//		no known node (-1) stay where they are. Fails also if
+			//		any of the pages was not moved. Linux only.
+			//
+			bool Place( const std::vector< int > & worker_nodes )
+			{
+				if( fData == nullptr || worker_nodes.empty() )
+					return true;
+
+			#if defined( __linux__ ) && defined( SYS_move_pages )
+				constexpr int	kMoveFlag { 1 << 1 };		// MPOL_MF_MOVE of numaif.h
+
+				const size_t kPage = size_t( sysconf( _SC_PAGESIZE ) );
+				const size_t kPages = ( fBytes + kPage - 1 ) / kPage;		// mmap gives a page aligned fData
+
+				std::vector< void * >	pages;
+				std::vector< int >		nodes;
+				for( size_t p = 0; p < kPages; ++ p )
+				{
+					const int kNode = worker_nodes[ BlockOwner( p * kPage / sizeof( double ), fSize, worker_nodes.size() ) ];
+					if( kNode < 0 )
+						continue;
+					pages.push_back( reinterpret_cast< char * >( fData ) + p * kPage );
+					nodes.push_back( kNode );
+				}
+
+				if( pages.empty() )
+					return true;
+
+				// Returns the number of the pages not moved, and their status is negative
+				std::vector< int >		status( pages.size(), -1 );
+				return syscall( SYS_move_pages, 0, pages.size(), pages.data(), nodes.data(), status.data(), kMoveFlag ) == 0
+						&& std::all_of( status.begin(), status.end(), [] ( int s ) { return s >= 0; } );
+			#else
+				return false;
+			#endif
+			}
+
+			double * data( void ) { return fData; }
+			const double * data( void ) const { return fData; }
+			size_t size( void ) const { return fSize; }
+
+			DataView View( void ) const { return DataView( fData, fSize ); }
+	};
+
+
+
+	///////////////////////////////////////////////////////////
+	// Finds how much of the data is not on its worker's node
+	///////////////////////////////////////////////////////////
+	//
+	// INPUT:
+	//		v - the data, processed in blocks as in BlockOwner
+	//		worker_nodes - the node of each worker (of PinThreadPool)
+	// OUTPUT:
+	//		the fraction [0,1] of the pages of v which are on another
+	//		node than their worker (of those with a known node),
+	//		or -1 if it cannot be found
+	//
+	// REMARKS:
+	//		The pages are queried with move_pages (it does not move
+	//		them if no nodes are given). This is what the kernels will
+	//		read over the interconnect. Linux only.
+	//
+	inline double RemotePageFraction( const DataView & v, const std::vector< int > & worker_nodes )
+	{
+	#if defined( __linux__ ) && defined( SYS_move_pages )
+		if( v.empty() || worker_nodes.empty() )
+			return -1.0;
+
+		const size_t kPage = size_t( sysconf( _SC_PAGESIZE ) );
+
+		const uintptr_t kFirst = reinterpret_cast< uintptr_t >( v.data() ) / kPage * kPage;
+		const uintptr_t kEnd = reinterpret_cast< uintptr_t >( v.data() + v.size() );
+		const size_t kPages = ( kEnd - kFirst + kPage - 1 ) / kPage;
+
+		std::vector< void * >	pages( kPages );
+		for( size_t p = 0; p < kPages; ++ p )
+			pages[ p ] = reinterpret_cast< void * >( kFirst + p * kPage );
+
+		std::vector< int >	status( kPages, -1 );
+		if( syscall( SYS_move_pages, 0, kPages, pages.data(), nullptr, status.data(), 0 ) != 0 )
+			return -1.0;
+
+		size_t remote {}, known {};
+		for( size_t p = 0; p < kPages; ++ p )
+		{
+			if( status[ p ] < 0 )
+				continue;		// not touched yet, or not there
+
+			// The worker of the first element on the page
+			const uintptr_t kAddr = std::max( kFirst + p * kPage, reinterpret_cast< uintptr_t >( v.data() ) );
+			const size_t kElem = ( kAddr - reinterpret_cast< uintptr_t >( v.data() ) ) / sizeof( double );
+
+			const int kNode = worker_nodes[ BlockOwner( kElem, v.size(), worker_nodes.size() ) ];
+			if( kNode < 0 )
+				continue;		// the CPU of the worker is on no known node
+
+			++ known;
+			if( status[ p ] != kNode )
+				++ remote;
+		}
+
+		return known > 0 ? double( remote ) / double( known ) : -1.0;
+	#else
+		( void ) v; ( void ) worker_nodes;
+		return -1.0;
+	#endif
+	}
+
+
+
+	// The allocation counters of all of the nodes, summed up
+	// (/sys/devices/system/node/node*/numastat); other_node counts the
+	// pages a process got from another node than the one it ran on.
+	struct NumaStat
+	{
+		uint64_t	fHit {}, fMiss {}, fLocal {}, fOther {};
+
+		static NumaStat Read( void )
+		{
+			NumaStat	st;
+			for( int n = 0; ; ++ n )
+			{
+				std::ifstream	file( "/sys/devices/system/node/node" + std::to_string( n ) + "/numastat" );
+				if( ! file )
+					break;
+
+				std::string		name;
+				uint64_t		val {};
+				while( file >> name >> val )
+				{
+					if( name == "numa_hit" )			st.fHit += val;
+					else if( name == "numa_miss" )		st.fMiss += val;
+					else if( name == "local_node" )		st.fLocal += val;
+					else if( name == "other_node" )		st.fOther += val;
+				}
+			}
+			return st;
+		}
+
+		NumaStat operator - ( const NumaStat & b ) const
+		{
+			return { fHit - b.fHit, fMiss - b.fMiss, fLocal - b.fLocal, fOther - b.fOther };
+		}
+	};
+
+
+}	// end of namespace
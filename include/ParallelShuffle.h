@@ -0,0 +1,145 @@
+#pragma once
+
+
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <future>
+
+#include "ThreadPool.h"
+#include "CounterRNG.h"
+
+
+
+namespace InnerProducts
+{
+
+
+	///////////////////////////////////////////////////////////
+	// Randomly permutes the data in parallel
+	///////////////////////////////////////////////////////////
+	//
+	// INPUT:
+	//		data - the array to shuffle (in place)
+	//		kElems - number of elements in data
+	//		seed - the key of the Philox generator
+	// OUTPUT:
+	//		none
+	//
+	// REMARKS:
+	//		Each element is sent to a random bucket, the buckets
+	//		are filled with a stable counting scatter (as in
+	//		RadixSortByMagnitude), then each bucket gets its own
+	//		Fisher-Yates shuffle. All of the random numbers come
+	//		from Philox at the counters given by the element
+	//		(or bucket) indices, and the scatter is stable, so the
+	//		result depends only on the seed - not on the number
+	//		of threads. The buckets are small enough to be
+	//		shuffled in the cache.
+	//
+	inline void ParallelShuffle( double * data, const size_t kElems, const uint64_t seed )
+	{
+		if( kElems < 2 )
+			return;
+
+		constexpr uint32_t	kBucketStream { 1 }, kSwapStream { 2 };
+
+		const Philox4x32	rng( seed );
+
+		const size_t kBuckets = std::clamp( kElems >> 12, size_t( 1 ), size_t( 4096 ) );
+
+		ThreadPool &	pool = GetThreadPool();
+
+		const size_t kBlocks = kElems < ( size_t( 1 ) << 16 ) || pool.IsWorker() ? 1 : pool.size();
+		const size_t kBlockSize = ( ( kElems + kBlocks - 1 ) / kBlocks + 3 ) & ~ size_t( 3 );		// a multiple of 4
+
+		// Runs fun( from, to, block_no ) for each block
+		auto run_blocks = [ & pool, kBlocks, kBlockSize, kElems ] ( auto fun )
+		{
+			std::vector< std::future< void > >	blocks;
+			for( size_t b = 0; b < kBlocks; ++ b )
+				blocks.push_back( pool.Submit( fun, std::min( b * kBlockSize, kElems ), std::min( ( b + 1 ) * kBlockSize, kElems ), b ) );
+			for( auto & f : blocks )
+				pool.Get( f );
+		};
+
+		// Calls fun( i, bucket ) for the elements [from,to), from is a multiple of 4;
+		// one Philox call gives the buckets of 4 elements
+		auto for_buckets = [ & rng, kBuckets ] ( const size_t from, const size_t to, auto fun )
+		{
+			for( size_t i = from; i < to; i += 4 )
+			{
+				const uint64_t kCtr = i / 4;
+				const auto r = rng( { uint32_t( kCtr ), uint32_t( kCtr >> 32 ), kBucketStream, 0 } );
+				for( size_t k = 0; k < 4 && i + k < to; ++ k )
+					fun( i + k, size_t( ( uint64_t( r[ k ] ) * kBuckets ) >> 32 ) );
+			}
+		};
+
+		std::vector< size_t >	hist( kBlocks * kBuckets );		// a histogram per block
+
+		run_blocks( [ & hist, & for_buckets, kBuckets ] ( size_t from, size_t to, size_t b )
+					{
+						size_t * h = & hist[ b * kBuckets ];
+						for_buckets( from, to, [ h ] ( size_t, size_t d ) { ++ h[ d ]; } );
+					} );
+
+		// Exclusive prefix sums in the ( bucket, block ) order, so the scatter is stable
+		std::vector< size_t >	bucket_begin( kBuckets + 1 );
+		size_t offset {};
+		for( size_t d = 0; d < kBuckets; ++ d )
+		{
+			bucket_begin[ d ] = offset;
+			for( size_t b = 0; b < kBlocks; ++ b )
+			{
+				const size_t kCount = hist[ b * kBuckets + d ];
+				hist[ b * kBuckets + d ] = offset;
+				offset += kCount;
+			}
+		}
+		bucket_begin[ kBuckets ] = offset;
+
+		std::vector< double >	buffer( kElems );
+
+		run_blocks( [ & hist, & for_buckets, & buffer, data, kBuckets ] ( size_t from, size_t to, size_t b )
+					{
+						size_t * h = & hist[ b * kBuckets ];
+						for_buckets( from, to, [ h, & buffer, data ] ( size_t i, size_t d ) { buffer[ h[ d ] ++ ] = data[ i ]; } );
+					} );
+
+		// Fisher-Yates in each bucket, then back to data
+		std::vector< std::future< void > >	tasks;
+		const size_t kBucketsPerTask = std::max( kBuckets / ( 4 * pool.size() ), size_t( 1 ) );
+		for( size_t d0 = 0; d0 < kBuckets; d0 += kBucketsPerTask )
+			tasks.push_back( pool.Submit( [ & rng, & bucket_begin, & buffer, data, kBuckets, kBucketsPerTask ] ( size_t first_bucket )
+							{
+								for( size_t d = first_bucket; d < std::min( first_bucket + kBucketsPerTask, kBuckets ); ++ d )
+								{
+									double * bucket = buffer.data() + bucket_begin[ d ];
+									const size_t kSize = bucket_begin[ d + 1 ] - bucket_begin[ d ];
+
+									Philox4x32::Counter r {};
+									for( size_t j = kSize; j-- > 1; )
+									{
+										if( j % 4 == 3 || j + 1 == kSize )
+											r = rng( { uint32_t( j / 4 ), uint32_t( d ), kSwapStream, 0 } );
+
+										std::swap( bucket[ j ], bucket[ ( uint64_t( r[ j % 4 ] ) * ( j + 1 ) ) >> 32 ] );
+									}
+
+									std::copy( bucket, bucket + kSize, data + bucket_begin[ d ] );
+								}
+							}, d0 ) );
+		for( auto & f : tasks )
+			pool.Get( f );
+	}
+
+
+	inline void ParallelShuffle( std::vector< double > & v, const uint64_t seed )
+	{
+		ParallelShuffle( v.data(), v.size(), seed );
+	}
+
+
+}	// end of namespace
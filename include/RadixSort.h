@@ -0,0 +1,149 @@
+#pragma once
+
+
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <future>
+
+#include "ThreadPool.h"
+
+
+
+namespace InnerProducts
+{
+
+
+	// The key of x for sorting by magnitude, i.e. the bit pattern of |x|.
+	// For the non-negative doubles the order of the bit patterns
+	// (as unsigned integers) is the same as the order of the values.
+	inline uint64_t MagnitudeKey( const double x )
+	{
+		uint64_t bits {};
+		std::memcpy( & bits, & x, sizeof( bits ) );
+		return bits & ~( uint64_t( 1 ) << 63 );
+	}
+
+
+
+	///////////////////////////////////////////////////////////
+	// Sorts data in ascending order of |data[ i ]|
+	///////////////////////////////////////////////////////////
+	//
+	// INPUT:
+	//		data - the array to sort (in place)
+	//		kElems - number of elements in data
+	//		buffer - a scratch buffer, resized to kElems if necessary;
+	//			it can be reused by the subsequent calls
+	//
+	// REMARKS:
+	//		This is a stable LSD radix sort on the 63-bit keys
+	//		of MagnitudeKey (6 passes of 11-bit digits), i.e. O(n)
+	//		with no fabs calls and no comparisons.
+	//		The passes in which all keys have the same digit
+	//		(e.g. the top exponent bits) are skipped.
+	//		Large arrays are split into one block per worker of
+	//		the thread pool; each block is histogrammed and then
+	//		scattered in parallel.
+	//
+	inline void RadixSortByMagnitude( double * data, const size_t kElems, std::vector< double > & buffer )
+	{
+		constexpr int		kDigitBits { 11 };
+		constexpr size_t	kBuckets { size_t( 1 ) << kDigitBits };
+		constexpr uint64_t	kDigitMask { kBuckets - 1 };
+		constexpr int		kPasses { ( 63 + kDigitBits - 1 ) / kDigitBits };
+
+		constexpr size_t	kMinParallelSize { size_t( 1 ) << 16 };
+
+		// Small arrays are faster with a comparison sort on the keys
+		if( kElems < 256 )
+		{
+			std::stable_sort( data, data + kElems, [] ( const double p, const double q ) { return MagnitudeKey( p ) < MagnitudeKey( q ); } );
+			return;
+		}
+
+		if( buffer.size() < kElems )
+			buffer.resize( kElems );
+
+		ThreadPool &	pool = GetThreadPool();
+
+		const size_t kBlocks = kElems < kMinParallelSize || pool.IsWorker() ? 1 : pool.size();
+		const size_t kBlockSize = ( kElems + kBlocks - 1 ) / kBlocks;
+
+		// Runs fun( block_begin, block_end, block_no ) for each block
+		auto run_blocks = [ & pool, kBlocks, kBlockSize, kElems ] ( auto fun )
+		{
+			if( kBlocks == 1 )
+			{
+				fun( size_t( 0 ), kElems, size_t( 0 ) );
+				return;
+			}
+
+			std::vector< std::future< void > >	blocks;
+			for( size_t b = 0; b < kBlocks; ++ b )
+				blocks.push_back( pool.Submit( fun, b * kBlockSize, std::min( ( b + 1 ) * kBlockSize, kElems ), b ) );
+			for( auto & f : blocks )
+				pool.Get( f );
+		};
+
+		std::vector< size_t >	hist( kBlocks * kBuckets );		// a histogram per block
+
+		double * src = data;
+		double * dst = buffer.data();
+
+		for( int pass = 0; pass < kPasses; ++ pass )
+		{
+			const int kShift = pass * kDigitBits;
+
+			run_blocks( [ & hist, src, kShift ] ( size_t from, size_t to, size_t b )
+						{
+							size_t * h = & hist[ b * kBuckets ];
+							std::fill( h, h + kBuckets, size_t() );
+							for( size_t i = from; i < to; ++ i )
+								++ h[ ( MagnitudeKey( src[ i ] ) >> kShift ) & kDigitMask ];
+						} );
+
+			// Nothing to do if all of the keys have the same digit
+			const uint64_t kFirstDigit = ( MagnitudeKey( src[ 0 ] ) >> kShift ) & kDigitMask;
+			size_t same_digit {};
+			for( size_t b = 0; b < kBlocks; ++ b )
+				same_digit += hist[ b * kBuckets + kFirstDigit ];
+			if( same_digit == kElems )
+				continue;
+
+			// Exclusive prefix sums in the ( digit, block ) order - this keeps the sort stable
+			size_t offset {};
+			for( size_t d = 0; d < kBuckets; ++ d )
+				for( size_t b = 0; b < kBlocks; ++ b )
+				{
+					const size_t kCount = hist[ b * kBuckets + d ];
+					hist[ b * kBuckets + d ] = offset;
+					offset += kCount;
+				}
+
+			run_blocks( [ & hist, src, dst, kShift ] ( size_t from, size_t to, size_t b )
+						{
+							size_t * h = & hist[ b * kBuckets ];
+							for( size_t i = from; i < to; ++ i )
+								dst[ h[ ( MagnitudeKey( src[ i ] ) >> kShift ) & kDigitMask ] ++ ] = src[ i ];
+						} );
+
+			std::swap( src, dst );
+		}
+
+		if( src != data )
+			std::copy( src, src + kElems, data );
+	}
+
+
+	// Sorts v by magnitude with a scratch buffer kept per thread
+	inline void RadixSortByMagnitude( std::vector< double > & v )
+	{
+		static thread_local std::vector< double >	buffer;
+		RadixSortByMagnitude( v.data(), v.size(), buffer );
+	}
+
+
+}	// end of namespace
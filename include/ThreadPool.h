@@ -0,0 +1,304 @@
+#pragma once
+
+
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <cassert>
+#include <limits>
+
+#if defined( __linux__ )
+	#include <pthread.h>
+	#include <sched.h>
+#endif
+
+
+
+namespace InnerProducts
+{
+
+
+	// A persistent pool of worker threads with one task deque per worker.
+	// A worker pops from the back of its own deque (LIFO, cache-hot tasks)
+	// and, when it runs dry, steals from the front of the others.
+	// Tasks submitted from outside of the pool are spread round-robin,
+	// tasks submitted by a worker go to its own deque.
+	class ThreadPool
+	{
+		public:
+
+			using Task = std::function< void( void ) >;
+
+		private:
+
+			struct WorkerQueue
+			{
+				std::mutex				fMutex;
+				std::deque< Task >		fTasks;
+			};
+
+			std::vector< std::unique_ptr< WorkerQueue > >	fQueues;
+			std::vector< std::thread >						fWorkers;
+
+			std::mutex					fSleepMutex;
+			std::condition_variable		fSleepCV;
+			size_t						fPending {};			// tasks pushed but not yet taken, guarded by fSleepMutex
+			bool						fStop { false };		// guarded by fSleepMutex
+
+			std::atomic< size_t >		fNextQueue {};
+
+			bool						fPinned { false };
+
+			// Identifies the current thread if it is a worker of any pool
+			inline static thread_local const ThreadPool *	sOwner { nullptr };
+			inline static thread_local size_t				sIndex {};
+
+		public:
+
+			///////////////////////////////////////////////////////////
+			// Constructor
+			///////////////////////////////////////////////////////////
+			//
+			// INPUT:
+			//		num_of_threads - number of workers; 0 means
+			//			std::thread::hardware_concurrency()
+			//
+			explicit ThreadPool( size_t num_of_threads = 0 )
+			{
+				if( num_of_threads == 0 )
+					num_of_threads = std::max( 1u, std::thread::hardware_concurrency() );
+
+				for( size_t i = 0; i < num_of_threads; ++ i )
+					fQueues.push_back( std::make_unique< WorkerQueue >() );
+
+				for( size_t i = 0; i < num_of_threads; ++ i )
+					fWorkers.emplace_back( [ this, i ] () { WorkerLoop( i ); } );
+			}
+
+			~ThreadPool()
+			{
+				{
+					std::lock_guard< std::mutex > lock( fSleepMutex );
+					fStop = true;
+				}
+				fSleepCV.notify_all();
+				for( auto & t : fWorkers )
+					t.join();
+			}
+
+			ThreadPool( const ThreadPool & ) = delete;
+			ThreadPool & operator = ( const ThreadPool & ) = delete;
+
+			size_t size( void ) const { return fWorkers.size(); }
+
+			// True if called from one of the workers of this pool
+			bool IsWorker( void ) const { return sOwner == this; }
+
+			// The index [0,size) of the calling worker, so a task
+			// can use per-thread data without any locking
+			size_t WorkerIndex( void ) const { assert( IsWorker() ); return sIndex; }
+
+			// Pins the worker i to the logical CPU cpu.
+			// Linux only - elsewhere it does nothing and returns false.
+			bool PinWorker( const size_t i, const unsigned cpu )
+			{
+			#if defined( __linux__ )
+				cpu_set_t	set;
+				CPU_ZERO( & set );
+				CPU_SET( cpu, & set );
+				const bool kOk = pthread_setaffinity_np( fWorkers[ i ].native_handle(), sizeof( set ), & set ) == 0;
+				fPinned = fPinned || kOk;
+				return kOk;
+			#else
+				( void ) i; ( void ) cpu;
+				return false;
+			#endif
+			}
+
+			// True if any of the workers is pinned
+			bool IsPinned( void ) const { return fPinned; }
+
+		public:
+
+			static constexpr size_t kAnyWorker { std::numeric_limits< size_t >::max() };
+
+			///////////////////////////////////////////////////////////
+			// Schedules fun( args ... ) for execution in the pool
+			///////////////////////////////////////////////////////////
+			//
+			// INPUT:
+			//		fun, args - a callable and its arguments (copied)
+			// OUTPUT:
+			//		std::future with the result of fun
+			//
+			template < typename F, typename ... Args >
+			auto Submit( F && fun, Args && ... args )
+			{
+				return SubmitTo( kAnyWorker, std::forward< F >( fun ), std::forward< Args >( args ) ... );
+			}
+
+			// As Submit, but the task goes to the deque of the given worker,
+			// so it runs there unless it is stolen by an idle one.
+			// This keeps a task close to its data on a NUMA machine.
+			template < typename F, typename ... Args >
+			auto SubmitTo( const size_t worker, F && fun, Args && ... args )
+			{
+				using R = std::invoke_result_t< std::decay_t< F >, std::decay_t< Args > ... >;
+
+				auto task = std::make_shared< std::packaged_task< R( void ) > >(
+								std::bind( std::forward< F >( fun ), std::forward< Args >( args ) ... ) );
+
+				auto result = task->get_future();
+
+				Push( [ task ] () { ( * task )(); }, worker );
+
+				return result;
+			}
+
+			///////////////////////////////////////////////////////////
+			// Returns the result of a future obtained from Submit
+			///////////////////////////////////////////////////////////
+			//
+			// REMARKS:
+			//		If called from a worker, then instead of blocking
+			//		it keeps on executing pending tasks. Thanks to this
+			//		a task can submit and wait for other tasks without
+			//		a deadlock.
+			//
+			template < typename R >
+			R Get( std::future< R > & fut )
+			{
+				if( IsWorker() )
+				{
+					while( fut.wait_for( std::chrono::seconds( 0 ) ) != std::future_status::ready )
+						if( ! RunOne( sIndex ) )
+							std::this_thread::yield();
+				}
+
+				return fut.get();
+			}
+
+		private:
+
+			void Push( Task && task, const size_t worker = kAnyWorker )
+			{
+				const size_t kQueue = worker != kAnyWorker ? worker % fQueues.size() : IsWorker() ? sIndex : fNextQueue ++ % fQueues.size();
+
+				{
+					// Counted first (and under the lock) not to lose a wake-up
+					// of a worker that is just going to sleep
+					std::lock_guard< std::mutex > lock( fSleepMutex );
+					++ fPending;
+				}
+
+				{
+					std::lock_guard< std::mutex > lock( fQueues[ kQueue ]->fMutex );
+					fQueues[ kQueue ]->fTasks.push_back( std::move( task ) );
+				}
+
+				fSleepCV.notify_one();
+			}
+
+			// Pops from the back of the own deque, or steals from the front of the others
+			bool TryTake( const size_t kOwn, Task & task )
+			{
+				{
+					auto & q = * fQueues[ kOwn ];
+					std::lock_guard< std::mutex > lock( q.fMutex );
+					if( ! q.fTasks.empty() )
+					{
+						task = std::move( q.fTasks.back() );
+						q.fTasks.pop_back();
+						return true;
+					}
+				}
+
+				for( size_t k = 1; k < fQueues.size(); ++ k )
+				{
+					auto & q = * fQueues[ ( kOwn + k ) % fQueues.size() ];
+					std::lock_guard< std::mutex > lock( q.fMutex );
+					if( ! q.fTasks.empty() )
+					{
+						task = std::move( q.fTasks.front() );
+						q.fTasks.pop_front();
+						return true;
+					}
+				}
+
+				return false;
+			}
+
+			bool RunOne( const size_t kOwn )
+			{
+				Task task;
+				if( ! TryTake( kOwn, task ) )
+					return false;
+
+				{
+					std::lock_guard< std::mutex > lock( fSleepMutex );
+					-- fPending;
+				}
+
+				task();
+				return true;
+			}
+
+			void WorkerLoop( const size_t kIndex )
+			{
+				sOwner = this;
+				sIndex = kIndex;
+
+				for( ;; )
+				{
+					if( RunOne( kIndex ) )
+						continue;
+
+					std::unique_lock< std::mutex > lock( fSleepMutex );
+					fSleepCV.wait( lock, [ this ] () { return fStop || fPending > 0; } );
+					if( fStop && fPending == 0 )
+						return;
+				}
+			}
+	};
+
+
+	namespace Detail
+	{
+		inline std::unique_ptr< ThreadPool > & ThePool( void )
+		{
+			static std::unique_ptr< ThreadPool >	thePool { std::make_unique< ThreadPool >() };
+			return thePool;
+		}
+	}
+
+
+	// The pool shared by all of the parallel inner products.
+	// It is created on the first use and lives until the program ends.
+	inline ThreadPool & GetThreadPool( void )
+	{
+		return * Detail::ThePool();
+	}
+
+
+	// Replaces the shared pool with one of num_of_threads workers
+	// (0 means std::thread::hardware_concurrency()).
+	// Must not be called while the pool has any tasks to do.
+	inline ThreadPool & ResetThreadPool( const size_t num_of_threads )
+	{
+		auto & pool = Detail::ThePool();
+		pool.reset();		// the old workers are joined first
+		pool = std::make_unique< ThreadPool >( num_of_threads );
+		return * pool;
+	}
+
+
+}	// end of namespace
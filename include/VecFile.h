@@ -0,0 +1,244 @@
+#pragma once
+
+
+
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#if defined( _WIN32 )
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#include "DataView.h"
+
+
+
+// The binary vector files: a 64-byte header followed by the raw doubles
+// in the native (little-endian) byte order. The data starts at a 64-byte
+// boundary, so a mapped file can be passed to the SIMD kernels as it is.
+
+namespace InnerProducts
+{
+
+
+	struct VecFileHeader
+	{
+		static constexpr char		kMagic[ 8 ] { 'I', 'P', 'V', 'E', 'C', 0, 0, 0 };
+		static constexpr uint32_t	kVersion { 1 };
+		static constexpr uint32_t	kByteOrderTag { 0x01020304 };		// reads differently on a machine of the other endianness
+
+		char		fMagic[ 8 ] { 'I', 'P', 'V', 'E', 'C', 0, 0, 0 };
+		uint32_t	fVersion { kVersion };
+		uint32_t	fByteOrder { kByteOrderTag };
+
+		int32_t		fDataType {};		// the FP_TestData_Type of the generator
+		int32_t		fExpDelta {};		// dExp of the generator
+		uint64_t	fSeed {};			// seed of the generator
+		uint64_t	fElems {};			// number of doubles that follow the header
+
+		uint8_t		fReserved[ 24 ] {};
+
+		bool IsValid( void ) const
+		{
+			return std::memcmp( fMagic, kMagic, sizeof( kMagic ) ) == 0 && fVersion == kVersion && fByteOrder == kByteOrderTag;
+		}
+
+		// True if both describe the same data set
+		bool Matches( const VecFileHeader & other ) const
+		{
+			return fDataType == other.fDataType && fExpDelta == other.fExpDelta && fSeed == other.fSeed && fElems == other.fElems;
+		}
+	};
+
+	static_assert( sizeof( VecFileHeader ) == 64, "The header of the vector file must be 64 bytes" );
+
+
+
+	// Writes the header and kElems = header.fElems doubles from data.
+	// Returns false if the file cannot be written.
+	inline bool WriteVecFile( const std::string & file_name, const VecFileHeader & header, const double * data )
+	{
+		std::ofstream	file( file_name, std::ios::binary | std::ios::trunc );
+		if( ! file )
+			return false;
+
+		file.write( reinterpret_cast< const char * >( & header ), sizeof( header ) );
+		file.write( reinterpret_cast< const char * >( data ), std::streamsize( header.fElems * sizeof( double ) ) );
+
+		return bool( file );
+	}
+
+
+
+	// A file mapped read-only into memory. Nothing is read until the data
+	// is touched, and the OS page cache keeps it for the next run.
+	class MappedFile
+	{
+		private:
+
+			const void *	fBase {};
+			size_t			fBytes {};
+			bool			fOpen {};		// an empty file is open, but not mapped
+
+		#if defined( _WIN32 )
+			HANDLE			fFile { INVALID_HANDLE_VALUE };
+			HANDLE			fMapping {};
+		#endif
+
+		public:
+
+			MappedFile( void ) = default;
+
+			explicit MappedFile( const std::string & file_name ) { Open( file_name ); }
+
+			~MappedFile() { Close(); }
+
+			MappedFile( const MappedFile & ) = delete;
+			MappedFile & operator = ( const MappedFile & ) = delete;
+
+			MappedFile( MappedFile && other ) noexcept { * this = std::move( other ); }
+			MappedFile & operator = ( MappedFile && other ) noexcept
+			{
+				if( this != & other )
+				{
+					Close();
+					std::swap( fBase, other.fBase );
+					std::swap( fBytes, other.fBytes );
+					std::swap( fOpen, other.fOpen );
+				#if defined( _WIN32 )
+					std::swap( fFile, other.fFile );
+					std::swap( fMapping, other.fMapping );
+				#endif
+				}
+				return * this;
+			}
+
+			// Maps the whole file; returns false if it cannot be mapped
+			bool Open( const std::string & file_name )
+			{
+				Close();
+
+			#if defined( _WIN32 )
+				fFile = CreateFileA( file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+				LARGE_INTEGER	size {};
+				if( fFile == INVALID_HANDLE_VALUE || ! GetFileSizeEx( fFile, & size ) )
+				{
+					Close();
+					return false;
+				}
+				fBytes = size_t( size.QuadPart );
+				if( fBytes > 0 )
+				{
+					fMapping = CreateFileMappingA( fFile, nullptr, PAGE_READONLY, 0, 0, nullptr );
+					fBase = fMapping != nullptr ? MapViewOfFile( fMapping, FILE_MAP_READ, 0, 0, 0 ) : nullptr;
+				}
+			#else
+				const int fd = open( file_name.c_str(), O_RDONLY );
+				if( fd < 0 )
+					return false;
+
+				struct stat		st {};
+				if( fstat( fd, & st ) != 0 )
+				{
+					close( fd );
+					return false;
+				}
+
+				fBytes = size_t( st.st_size );
+				if( fBytes > 0 )
+				{
+					void * base = mmap( nullptr, fBytes, PROT_READ, MAP_SHARED, fd, 0 );
+					if( base != MAP_FAILED )
+					{
+						fBase = base;
+						madvise( base, fBytes, MADV_SEQUENTIAL );
+					}
+				}
+				close( fd );		// the mapping stays valid
+			#endif
+
+				fOpen = fBytes == 0 || fBase != nullptr;
+				if( ! fOpen )
+					Close();
+
+				return fOpen;
+			}
+
+			void Close( void )
+			{
+			#if defined( _WIN32 )
+				if( fBase != nullptr )
+					UnmapViewOfFile( fBase );
+				if( fMapping != nullptr )
+					CloseHandle( fMapping );
+				if( fFile != INVALID_HANDLE_VALUE )
+					CloseHandle( fFile );
+				fMapping = nullptr;
+				fFile = INVALID_HANDLE_VALUE;
+			#else
+				if( fBase != nullptr )
+					munmap( const_cast< void * >( fBase ), fBytes );
+			#endif
+				fBase = nullptr;
+				fBytes = 0;
+				fOpen = false;
+			}
+
+			bool IsOpen( void ) const { return fOpen; }
+
+			const char * data( void ) const { return static_cast< const char * >( fBase ); }
+			size_t size( void ) const { return fBytes; }
+	};
+
+
+
+	// A vector file mapped into memory - the data is used in place
+	class MappedVecFile
+	{
+		private:
+
+			MappedFile		fFile;
+
+		public:
+
+			MappedVecFile( void ) = default;
+
+			explicit MappedVecFile( const std::string & file_name ) { Open( file_name ); }
+
+			// Maps the file; returns false if it cannot be mapped,
+			// or it is not a valid vector file, or it is truncated.
+			bool Open( const std::string & file_name )
+			{
+				if( ! fFile.Open( file_name ) || fFile.size() < sizeof( VecFileHeader )
+					|| ! Header().IsValid() || ( fFile.size() - sizeof( VecFileHeader ) ) / sizeof( double ) < Header().fElems )
+				{
+					fFile.Close();
+					return false;
+				}
+
+				return true;
+			}
+
+			bool IsOpen( void ) const { return fFile.IsOpen(); }
+
+			const VecFileHeader & Header( void ) const { return * reinterpret_cast< const VecFileHeader * >( fFile.data() ); }
+
+			const double * data( void ) const { return reinterpret_cast< const double * >( fFile.data() + sizeof( VecFileHeader ) ); }
+			size_t size( void ) const { return IsOpen() ? size_t( Header().fElems ) : 0; }
+
+			DataView View( void ) const { return IsOpen() ? DataView( data(), size() ) : DataView(); }
+	};
+
+
+}	// end of namespace
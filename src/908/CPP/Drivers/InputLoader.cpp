@@ -0,0 +1,119 @@
+#include "InputLoader.h"
+
+#include <string.h>
+#include <algorithm>
+#include <charconv>
+#include <thread>
+
+// The smallest chunk a thread gets, smaller files are parsed serially
+#define MIN_CHUNK_BYTES (1 << 20)
+
+// Returns the number of lines in [begin, end); the last line need not end with '\n'
+static size_t CountLines(const char *begin, const char *end)
+{
+	size_t n = 0;
+	for (const char *p = begin; (p = (const char *)memchr(p, '\n', end - p)) != NULL; p++)
+		n++;
+	if (begin != end && end[-1] != '\n')
+		n++;
+	return n;
+}
+
+// Parses the lines of [begin, end) to out; returns false on a bad line
+// Note: as atol(), leading blanks are skipped and an empty line gives 0
+static bool ParseLines(const char *begin, const char *end, double *out)
+{
+	const char *p = begin;
+	while (p < end)
+	{
+		const char *eol = (const char *)memchr(p, '\n', end - p);
+		if (eol == NULL)
+			eol = end;
+
+		while (p < eol && (*p == ' ' || *p == '\t'))
+			p++;
+		if (p < eol && *p == '+')
+			p++;
+
+		int64_t bits = 0;
+		if (p < eol && *p != '\r')
+		{
+			const std::from_chars_result r = std::from_chars(p, eol, bits);
+			if (r.ec != std::errc() || (r.ptr != eol && *r.ptr != '\r' && *r.ptr != ' ' && *r.ptr != '\t'))
+				return false;
+		}
+
+		memcpy(out++, &bits, sizeof(bits));
+		p = eol + 1;
+	}
+	return true;
+}
+
+bool InputData::Load(const std::string &file_name, unsigned n_threads)
+{
+	text_nums.clear();
+	if (bin_file.Open(file_name))
+		return true;
+
+	InnerProducts::MappedFile file;
+	if (!file.Open(file_name))
+		return false;
+
+	const char *text = file.data();
+	const size_t bytes = file.size();
+
+	if (n_threads == 0)
+		n_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	const size_t n_chunks = std::max<size_t>(std::min<size_t>(n_threads, bytes / MIN_CHUNK_BYTES), 1);
+
+	// The chunk borders are moved to the line starts
+	std::vector<const char *> border(n_chunks + 1);
+	border[0] = text;
+	border[n_chunks] = text + bytes;
+	for (size_t c = 1; c < n_chunks; c++)
+	{
+		const char *p = std::max(text + c * (bytes / n_chunks), border[c - 1]);
+		const char *eol = (const char *)memchr(p, '\n', text + bytes - p);
+		border[c] = eol != NULL ? eol + 1 : text + bytes;
+	}
+
+	// Runs fun(c) for each chunk, one thread per chunk
+	auto for_chunks = [n_chunks](auto fun)
+	{
+		std::vector<std::thread> threads;
+		for (size_t c = 1; c < n_chunks; c++)
+			threads.emplace_back(fun, c);
+		fun(0);
+		for (auto &t : threads)
+			t.join();
+	};
+
+	// 1st pass: the lines of each chunk give its place in the output
+	std::vector<size_t> first(n_chunks + 1);
+	for_chunks([&](size_t c) { first[c + 1] = CountLines(border[c], border[c + 1]); });
+	for (size_t c = 0; c < n_chunks; c++)
+		first[c + 1] += first[c];
+
+	// 2nd pass: parsing
+	text_nums.resize(first[n_chunks]);
+	std::vector<char> ok(n_chunks);
+	for_chunks([&](size_t c) { ok[c] = ParseLines(border[c], border[c + 1], text_nums.data() + first[c]); });
+
+	if (std::find(ok.begin(), ok.end(), 0) != ok.end())
+	{
+		text_nums.clear();
+		return false;
+	}
+	return true;
+}
+
+bool WriteBinaryInput(const std::string &file_name, const double *nums, size_t n,
+	int pflag, int deltaExp, uint64_t seed)
+{
+	InnerProducts::VecFileHeader header;
+	header.fDataType = pflag;
+	header.fExpDelta = deltaExp;
+	header.fSeed = seed;
+	header.fElems = n;
+	return InnerProducts::WriteVecFile(file_name, header, nums);
+}
@@ -0,0 +1,46 @@
+// InputLoader.h and InputLoader.cpp read the summands of the driver's
+// file mode, and write them in the binary format.
+
+// Two input formats are accepted:
+// (1) binary - a vector file (see include/VecFile.h): a 64-byte header and
+//     the raw doubles; it is mapped into memory, nothing is parsed;
+// (2) text - one summand per line, written as the 64-bit integer with the
+//     bit pattern of the double (as printed by "main n exp pflag generate").
+//     The file is mapped and split into chunks at the line ends, and the
+//     chunks are parsed in parallel with std::from_chars.
+// The format is recognized by the header, so both can be passed as $1.
+
+#ifndef INPUT_LOADER_H
+#define INPUT_LOADER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "VecFile.h"		// include/ of the repository, see the Makefile
+
+// The summands of an input file, 0-based
+class InputData
+{
+private:
+	InnerProducts::MappedVecFile bin_file;   // set for a binary file
+	std::vector<double> text_nums;           // set for a text file
+
+public:
+	// Returns false if the file cannot be read or a line is not a number
+	// Note: n_threads == 0 uses all the hardware threads
+	bool Load(const std::string &file_name, unsigned n_threads = 0);
+
+	bool IsBinary() const { return bin_file.IsOpen(); }
+
+	const double *data() const { return IsBinary() ? bin_file.data() : text_nums.data(); }
+	size_t size() const { return IsBinary() ? bin_file.size() : text_nums.size(); }
+};
+
+// Writes nums[0] ... nums[n-1] to a binary vector file, the generator
+// parameters go to the header; returns false if it cannot be written
+bool WriteBinaryInput(const std::string &file_name, const double *nums, size_t n,
+	int pflag, int deltaExp, uint64_t seed);
+
+#endif
@@ -14,6 +14,10 @@
 // should be same. Furthermore, the results are all zero when $3 is
 // set to 4. Please check the compiler options in ExactSum.h.
 //
+// "main $1 $2 $3 generate" prints the data (one summand per line, as the
+// integer with the bits of the double), and "main $1 $2 $3 generate file"
+// writes it to a binary file. Either file can then be summed with "main file".
+//
 // If this program does not work correctly on your machine, please
 // email me the running arguments, the output, the error message if
 // any, and your system information (CPU, Operating System, etc).
@@ -24,6 +28,7 @@
 #include <time.h>
 #include <math.h>
 #include "ExactSum.h"
+#include "InputLoader.h"
 
 
 
@@ -83,27 +88,22 @@ int main(int argn, char* argc[])
 	double time_spent;
 	
 	if (argn == 2) {
-		// Input file name
-		MAXNUM = 0;
-		char line[1000];
-		FILE* fp = fopen(argc[1], "r");
-		while (fgets(line, sizeof(line), fp) != NULL) {
-			MAXNUM++;
+		// Input file name, a binary (mapped) or a text file (parsed in parallel)
+		InputData input;
+		if (!input.Load(argc[1])) {
+			printf("cannot read %s\n", argc[1]);
+			return 0;
 		}
-		fclose(fp);
-		
-		double* numbers = new double[MAXNUM + 1];
-		fp = fopen(argc[1], "r");
-		int i = 1;
-		while (fgets(line, sizeof(line), fp) != NULL) {
-			long temp = atol(line);
-			numbers[i++] = *((double*)(&temp));
-		}
-		fclose(fp);
 		
 		ExactSum mysum;
 		
 		
+		// iFastSum destroys its input, so it runs on a 1-based copy
+		// of the (mapped) data, made before the timing
+		MAXNUM = (int)input.size();
+		double* numbers = new double[MAXNUM + 1];
+		memcpy(numbers + 1, input.data(), MAXNUM * sizeof(double));
+		
 		begin = clock();
 		double result_iFastSum=mysum.iFastSum(numbers, MAXNUM);
 		end = clock();
@@ -111,10 +111,11 @@ int main(int argn, char* argc[])
 		time_spent = (double)(end - begin) / CLOCKS_PER_SEC;
 		printf("iFastSum is done in %f seconds. Result is %g\n", time_spent, result_iFastSum);
 		
+		delete[] numbers;
 		return 0;
 	}
 
-	if(argn!=4 && argn != 5)  // n, exp, pflag 
+	if(argn!=4 && argn != 5 && argn != 6)  // n, exp, pflag [generate [file]]
 	{
 		printf("wrong arguments\n");
 		return 0;
@@ -149,7 +150,8 @@ int main(int argn, char* argc[])
 		return 0;
 	}
 
-	srand((unsigned)time(NULL));
+	const unsigned seed = (unsigned)time(NULL);
+	srand(seed);
 	int i;
 
 	double *num_list;
@@ -187,11 +189,18 @@ int main(int argn, char* argc[])
 		original_list[y]=temp;
 	}
 	
+	if (argn == 6 && !strncmp(argc[4], "generate", 8)) {
+		// Store the data only, in the binary format
+		if (!WriteBinaryInput(argc[5], original_list + 1, MAXNUM, pflag, deltaExp, seed))
+			printf("cannot write %s\n", argc[5]);
+		return 0;
+	}
+
 	if (argn == 5 && !strncmp(argc[4], "generate", 8)) {
 		// Store the data only
 		for(i=1;i<=MAXNUM;i++) {
-			long longVal = *((long*)(original_list + i));
-			printf("%ld\n", longVal);
+			long long longVal = *((long long*)(original_list + i));
+			printf("%lld\n", longVal);
 		}
 		return 0;
 	}
@@ -1,21 +1,26 @@
 // Author: Yong-Kang Zhu (yongkang.zhu@gmail.com)
 // Code can be used only for academic purpose
 
+#include <math.h>
+#include <string.h>
 #include "ExactSum.h"
 
 ExactSum::ExactSum()
 {
-	set_fpu(0x27F);
-	r_c = 0;
-	t_s = new double[N2_EXPONENT + 1];
-	t_s2 = new double[N2_EXPONENT + 1];
+	// the FPU control word is per thread, so set it once in each one
+	static thread_local bool fpu_set = false;
+	if (!fpu_set)
+	{
+		set_fpu(0x27F);
+		fpu_set = true;
+	}
+	t_s = t_s_buf;
+	t_s2 = t_s2_buf;
 	Reset();
 }
 
 ExactSum::~ExactSum()
 {
-	delete [] t_s;
-	delete [] t_s2;
 }
 
 void ExactSum::set_fpu (unsigned int mode)
@@ -47,13 +52,30 @@ int ExactSum::Round3(double s0, double s1, double s2)
 }	
 
 double ExactSum::iFastSum(double *num_list, int n)
+{
+	if (n < 1) return .0;
+	return iFastSum(num_list, (size_t)n, 0);
+}
+
+double ExactSum::iFastSum(ConstDoubleSpan nums)
+{
+	// iFastSum destroys its input, so it runs on a copy (1-based)
+	double *num_list = new double[nums.size + 1];
+	for (size_t i = 0; i < nums.size; i++)
+		num_list[i + 1] = nums.data[i];
+	double s = iFastSum(num_list, nums.size, 0);
+	delete[] num_list;
+	return s;
+}
+
+double ExactSum::iFastSum(double *num_list, size_t n, int r_c)
 {
 	if (n < 1) return .0;
 	double s = 0, s_t, s1, s2, e1, e2;
-	int count;          // next position in num_list to store error
-	int c_n = n;          // current number of summands
+	size_t count;          // next position in num_list to store error
+	size_t c_n = n;          // current number of summands
 	unsigned max = 0;     // the max exponent of s_t
-	int i;
+	size_t i;
 	double t, e_m;
 	double half_ulp = .0;  // half an ulp of s
 
@@ -131,11 +153,9 @@ double ExactSum::iFastSum(double *num_list, int n)
 			if (s + s1 != s || s + s2 != s || 
 				Round3(s, s1, e1) || Round3(s, s2, e2))
 			{
-				r_c = 1;
-				double s1 = iFastSum(num_list, c_n);
+				double s1 = iFastSum(num_list, c_n, 1);
 				AddTwo(s, s1);
-				double s2 = iFastSum(num_list, c_n);
-				r_c = 0;
+				double s2 = iFastSum(num_list, c_n, 1);
 				if (Round3(s, s1, s2))
 				{
 					((str_double*)(&s1))->mantissa_low |= 0x1;   // the Magnify function
@@ -149,22 +169,31 @@ double ExactSum::iFastSum(double *num_list, int n)
 
 double ExactSum::OnlineExactSum(double *num_list, int n)
 {
+	if (n < 1) return .0;
+	return OnlineExactSum(ConstDoubleSpan(num_list + 1, (size_t)n));
+}
+
+double ExactSum::OnlineExactSum(ConstDoubleSpan nums)
+{
+	const double *num_list = nums.data;
+	size_t n = nums.size;
 	if (n < 1) return .0;
 	double *temp_swap;
-	// create two accumulators
-	double *temp_ss = new double[N2_EXPONENT + 1];
-	double *temp_ss2 = new double[N2_EXPONENT + 1];
+	// two accumulators, once per thread
+	static thread_local double temp_buf[2][N2_EXPONENT + 1];
+	double *temp_ss = temp_buf[0];
+	double *temp_ss2 = temp_buf[1];
 	double t;
-	int i;
+	size_t i;
 	unsigned exp;
 	double s;
 	for (i = 0; i < N2_EXPONENT; i++)
 		temp_ss[i] = .0;
 
-	int num = n > MAX_N ? MAX_N : n;
+	size_t num = n > MAX_N ? MAX_N : n;
 	while (1)
 	{
-		for (i = 1; i <= num; i++)
+		for (i = 0; i < num; i++)
 		{
 			exp = ((str_double*)(&num_list[i]))->exponent;
 			// AddTwo combined with an addition
@@ -200,42 +229,45 @@ double ExactSum::OnlineExactSum(double *num_list, int n)
 		else
 			break;
 	}
-	int j = 0;
+	size_t j = 0;
 	// extract all the non-zero accumulators
 	for (i = 0; i < N2_EXPONENT; i++)
 		if (temp_ss[i] != .0)
 			temp_ss2[++j] = temp_ss[i];
-	s = iFastSum(temp_ss2, j);
-	delete [] temp_ss;
-	delete [] temp_ss2;
+	s = iFastSum(temp_ss2, j, 0);
 	return s;
 }
 
-void ExactSum::AddNumber(double x)
+void ExactSum::Renormalize()
 {
 	int i;
 	double t;
 	unsigned exp;
-	if (c_num >= MAX_N)
+	for (i = 0; i < N2_EXPONENT; i++)
+		t_s2[i] = 0;
+	for (i = 0; i < N2_EXPONENT; i++)
 	{
-			for (i = 0; i < N2_EXPONENT; i++)
-				t_s2[i] = 0;
-			for (i = 0; i < N2_EXPONENT; i++)
-			{
-				exp = ((str_double*)(&t_s[i]))->exponent;
-				// AddTwo, inline
-				t = t_s2[exp] + t_s[i];
-				t_s2[exp + N_EXPONENT] +=
-						((str_double*)(&t_s2[exp]))->exponent
-						< exp ? (t_s[i] - t) + t_s2[exp]
-						: (t_s2[exp] - t) + t_s[i];
-				t_s2[exp] = t;
-			}
-			double *t_swap = t_s;
-			t_s = t_s2;
-			t_s2 = t_swap;
-			c_num = N2_EXPONENT;  // t_s has added N2_EXPONENT numbers
+		exp = ((str_double*)(&t_s[i]))->exponent;
+		// AddTwo, inline
+		t = t_s2[exp] + t_s[i];
+		t_s2[exp + N_EXPONENT] +=
+				((str_double*)(&t_s2[exp]))->exponent
+				< exp ? (t_s[i] - t) + t_s2[exp]
+				: (t_s2[exp] - t) + t_s[i];
+		t_s2[exp] = t;
 	}
+	double *t_swap = t_s;
+	t_s = t_s2;
+	t_s2 = t_swap;
+	c_num = N2_EXPONENT;  // t_s has added N2_EXPONENT numbers
+}
+
+void ExactSum::AddNumber(double x)
+{
+	double t;
+	unsigned exp;
+	if (c_num >= MAX_N)
+		Renormalize();
 
 	exp = ((str_double*)(&x))->exponent;
 	// AddTwo, inline
@@ -251,19 +283,27 @@ void ExactSum::AddNumber(double x)
 void ExactSum::AddArray(double *num_list, int n)
 {
 	if (n < 1) return ;
+	AddArray(ConstDoubleSpan(num_list + 1, (size_t)n));
+}
+
+void ExactSum::AddArray(ConstDoubleSpan nums)
+{
+	const double *num_list = nums.data;
+	size_t n = nums.size;
 
 	// we could use AddNumber directly, but the following is more efficient
-	int i;
+	size_t i;
 	double t;
 	unsigned exp;
 
-	int num = (n > MAX_N - c_num) ? MAX_N - c_num : n;
-	
-	c_num += num;
-
-	while (1)
+	while (n > 0)
 	{
-		for (i = 1; i <= num; i++)
+		if (c_num >= MAX_N)
+			Renormalize();
+		size_t num = (n > (size_t)(MAX_N - c_num)) ? MAX_N - c_num : n;
+		c_num += (int)num;
+
+		for (i = 0; i < num; i++)
 		{
 			exp = ((str_double*)(&num_list[i]))->exponent;
 			// AddTwo combined with an addition
@@ -274,42 +314,86 @@ void ExactSum::AddArray(double *num_list, int n)
 					: (t_s[exp] - t) + num_list[i];
 			t_s[exp] = t;
 		}
-		if (num < n)
+		num_list += num;
+		n -= num;
+	}
+}
+
+// The biased exponent of x, read with memcpy (not through a str_double
+// pointer) since x is a local variable here, not a member of an array
+static inline unsigned biased_exponent(double x)
+{
+	str_double d;
+	memcpy(&d, &x, sizeof(d));
+	return d.exponent;
+}
+
+void ExactSum::AddProducts(const double *v, const double *w, size_t n, double *abs_sum)
+{
+	size_t i = 0, end;
+	double t, p, e, a = .0;
+	unsigned exp;
+
+	while (i < n)
+	{
+		// each product gives two summands
+		if (c_num >= MAX_N - 1)
+			Renormalize();
+		end = i + (MAX_N - c_num) / 2;
+		if (end > n)
+			end = n;
+		c_num += (int)(2 * (end - i));
+
+		for (; i < end; i++)
 		{
-			for (i = 0; i < N2_EXPONENT; i++)
-				t_s2[i] = .0;
-			for (i = 0; i < N2_EXPONENT; i++)
+			p = v[i] * w[i];
+			e = fma(v[i], w[i], -p);   // p + e == v[i] * w[i] exactly
+			if (abs_sum)
+				a += fabs(p);
+
+			exp = biased_exponent(p);
+			// AddTwo combined with an addition
+			t = t_s[exp] + p;
+			t_s[exp + N_EXPONENT] +=
+					((str_double*)(&t_s[exp]))->exponent
+					< exp ? (p - t) + t_s[exp]
+					: (t_s[exp] - t) + p;
+			t_s[exp] = t;
+
+			if (e != .0)
 			{
-				exp = ((str_double*)(&t_s[i]))->exponent;
-				t = t_s2[exp] + t_s[i];
-				t_s2[exp + N_EXPONENT] +=
-						((str_double*)(&t_s2[exp]))->exponent
-						< exp ? (t_s[i] - t) + t_s2[exp]
-						: (t_s2[exp] - t) + t_s[i];
-				t_s2[exp] = t;
+				exp = biased_exponent(e);
+				t = t_s[exp] + e;
+				t_s[exp + N_EXPONENT] +=
+						((str_double*)(&t_s[exp]))->exponent
+						< exp ? (e - t) + t_s[exp]
+						: (t_s[exp] - t) + e;
+				t_s[exp] = t;
 			}
-			num_list += num;
-			n -= num;
-			num = (n > MAX_N_AFTER_SWAP) ?  MAX_N_AFTER_SWAP : n;
-			// Swap the pointers of two accumulators
-			double *t_swap = t_s;
-			t_s = t_s2;
-			t_s2 = t_swap;
-			c_num = N2_EXPONENT;  // t_s has added N2_EXPONENT numbers
 		}
-		else
-			break;
 	}
+
+	if (abs_sum)
+		*abs_sum += a;
+}
+
+void ExactSum::Merge(const ExactSum &other)
+{
+	int i;
+	// the accumulators of other are just summands for this one
+	for (i = 0; i < N2_EXPONENT; i++)
+		if (other.t_s[i] != .0)
+			AddNumber(other.t_s[i]);
 }
 
 double ExactSum::GetSum()
 {
-	int i, j = 0;
+	size_t i, j = 0;
 	// same to iHyrbidSum: use iFastSum to sum all the non-zero accumulators
 	for (i = 0; i < N2_EXPONENT; i++)
 		if (t_s[i] != .0)
 			t_s2[++j] = t_s[i];
-	return iFastSum(t_s2, j);
+	return iFastSum(t_s2, j, 0);
 }
 
 void ExactSum::Reset()
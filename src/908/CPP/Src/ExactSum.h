@@ -16,6 +16,8 @@
 // (5) PowerPC with GCC/G++: -O1 -DREV
 // (6) x86 with Mac OS X: -O1
 
+#include <stddef.h>
+
 // the number of exponents for IEEE754 double
 #define N_EXPONENT 2048
 
@@ -45,22 +47,43 @@ struct str_double
 #endif
 };
 
+// A read-only view of a 0-based array of doubles (as std::span<const double>
+// of C++20), it can be made from a pointer and a size or from any
+// contiguous container, e.g. std::vector<double>
+struct ConstDoubleSpan
+{
+	const double *data;
+	size_t size;
+
+	ConstDoubleSpan(const double *d, size_t n) : data(d), size(n) {}
+
+	template <class C, class = decltype(((const C*)0)->data())>
+	ConstDoubleSpan(const C &c) : data(c.data()), size(c.size()) {}
+};
+
 // Computes a sum which is guaranteed-accurate
-// Note: not synchronized
+// Note: Part A (iFastSum, OnlineExactSum) can be called concurrently,
+//       Part B is not synchronized - use one instance per thread and Merge()
 class ExactSum
 {
 private:
-	int r_c;      // a global used by iFastSum
-
 	// Part B
 	int c_num;    // number of the summands which have been accumulated
 
 	// accumulators of OnlineExactSum used by Part B
-	double *t_s, *t_s2;
+	// (kept in the object, so it does not touch the heap)
+	double t_s_buf[N2_EXPONENT + 1], t_s2_buf[N2_EXPONENT + 1];
+	double *t_s, *t_s2;   // point to the above, swapped when renormalized
 
 	// Return 1 if not correctly rounded; 0 otherwise
 	int Round3(double s0, double s1, double s2);
 
+	// iFastSum; r_c is 1 in the recursive calls
+	double iFastSum(double *num_list, size_t n, int r_c);
+
+	// Sums t_s into t_s2 and swaps them, called when c_num reaches MAX_N
+	void Renormalize();
+
 	// set the rounding mode to the double precision
   void set_fpu (unsigned int mode);
 
@@ -68,6 +91,10 @@ public:
 	ExactSum();
 	~ExactSum();
 
+	// t_s and t_s2 point to the own buffers, so no copies
+	ExactSum(const ExactSum &) = delete;
+	ExactSum &operator=(const ExactSum &) = delete;
+
 	// Dekker's algorithm: Exact Addition for 2 numbers
 	void AddTwo(double &a, double &b);
 
@@ -82,10 +109,19 @@ public:
 	// Note: a. the array starts from [1]
 	//       b. after execution, num_list does not change
 	//       c. to satisfy b., it does not call iFastSum if n < 2000
+	//       d. the temporary accumulators are thread-local, i.e. there
+	//          is no allocation per call
 	// Comment: since iFastSum is empirically faster when n < 2000,
 	//          users can call iFastSum if n < 2000, and OnlineExactSum otherwise
 	double OnlineExactSum(double *num_list, int n);
 
+	// The same as above, but for the 0-based arrays of any (64-bit) size
+	// Note: the input does not change - iFastSum works on a copy of it
+	//       (on the heap, 1-based), OnlineExactSum needs none; so, as above,
+	//       OnlineExactSum is the one for the large arrays
+	double iFastSum(ConstDoubleSpan nums);
+	double OnlineExactSum(ConstDoubleSpan nums);
+
 
 	// Part B: Online Summation if summands are not given at once, i.e.,
 	//         users can feed a number or an array, and get a sum at any time
@@ -98,6 +134,24 @@ public:
 	// Adds an array, and is used with GetSum()
 	void AddArray(double *num_list, int n);
 
+	// Adds a 0-based array of any (64-bit) size, and is used with GetSum()
+	void AddArray(ConstDoubleSpan nums);
+
+	// Adds the inner product of v and w (v[0] ... v[n-1]), and is used with GetSum()
+	// Note: a. each product is split into its rounded value and its exact
+	//          rounding error (by FMA), and both are accumulated, i.e. the
+	//          result is the correctly rounded exact inner product, barring
+	//          underflow (the error of FMA is not exact if it is subnormal)
+	//       b. no temporary array of the products is needed
+	//       c. if abs_sum is not NULL, the sum of |v[i]*w[i]| (of the
+	//          rounded products) is added to *abs_sum in the same loop
+	void AddProducts(const double *v, const double *w, size_t n, double *abs_sum = NULL);
+
+	// Adds all the accumulators of other, and is used with GetSum()
+	// Note: the result is exact, so the partial sums of many instances
+	//       (e.g. one per thread) can be combined and rounded only once
+	void Merge(const ExactSum &other);
+
 	// Returns the current sum
 	// Also see AddNumber()
 	double GetSum();
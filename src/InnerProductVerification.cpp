@@ -23,6 +23,7 @@
 #include <valarray>
 
 #include <cassert>
+#include <cstring>
 
 #include <execution>
 
@@ -34,8 +35,25 @@
 
 #include <fstream>
 #include <iterator>
+#include <filesystem>
 
 #include "range.h"
+#include "ThreadPool.h"
+#include "ErrorFreeTransforms.h"
+#include "InnerProductSIMD.h"
+#include "LongAccumulator.h"
+#include "RadixSort.h"
+#include "CounterRNG.h"
+#include "ParallelShuffle.h"
+#include "DataView.h"
+#include "VecFile.h"
+#include "Benchmark.h"
+#include "BenchmarkReport.h"
+#include "ExperimentConfig.h"
+#include "AutoTune.h"
+#include "NumaSupport.h"
+#include "CompensatedGEMV.h"
+#include "GramMatrix.h"
 
 #include "..\..\ttmath\ttmath.h"
 
@@ -51,6 +69,8 @@ namespace InnerProducts
 {
 
 	using DVec = vector< double >;
+	using DView = DataView;		// what the kernels take - a vector or a mapped data file
+	using FView = FloatView;	// and the float kernels
 	using DT = DVec::value_type;
 	using ST = DVec::size_type;
 
@@ -71,138 +91,182 @@ namespace InnerProducts
 		private:
 
 			// xxxxxxxxxxxxxxxxxxx
+			// The data sets of the 908 test driver, generated in parallel
+			// on the counter-based Philox generator
 			struct _908_sandbox
 			{
 	
-				//int pflag;  //program flag (Data type 1 to 4)
 				int pflag { 1 };  //program flag (Data type 1 to 4)
-				// random flop generator with exponent differece expo
 
-				int rflag=0;
+				uint64_t	fSeed {};
 
-				double ret_saved;
+				static constexpr size_t kBlockSize { size_t( 1 ) << 16 };		// the work unit, also of the partial sums
 
-				double Rand(int expo)
+				// The random flop of the index i with the exponent difference expo.
+				// Same as the 908 Rand(), but a function of ( fSeed, i ) only.
+				double Rand( const Philox4x32 & rng, const uint64_t i, const int expo ) const
 				{
-					double ret;
-					unsigned int low=0,high=0;
-					int i;
-					for(i=0;i<32;i++)
-					{
-						if(rand() & 0x1)
-							low=(low>>1) | 0x80000000;
-						else
-							low=low>>1;
-					}
-					for(i=0;i<32;i++)
-					{
-						if(rand() & 0x1)
-							high=(high>>1) | 0x80000000;
-						else
-							high=high>>1;
-					}
-					*(int*)(&ret)=low;
-					*(((int*)&ret)+1)=high;
-					if(expo!=0)
-						((str_double*)&ret)->exponent=((rand()%(expo))-expo/2)+0x3ff;
-					else 
-						((str_double*)&ret)->exponent=0x3ff;
-					if(pflag==2 || pflag==3)
-						return ret;  //pflag=2, random data
-					if(pflag==1)
-						rflag=0;     //pflag=1, well-conditioned data
-					if(rflag==0)  // exact zero
-					{
-						ret_saved=ret;
-						((str_double*)(&ret))->sign=1;
-						rflag=1;
-					}
+					// pflag=4 - exact zero, the consecutive pairs are -x, +x
+					const uint64_t kIdx = pflag == 4 ? i / 2 : i;
+
+					const auto kBits = rng.Bits128( kIdx, ( uint64_t( pflag ) << 32 ) | uint32_t( expo ) );
+
+					const uint64_t kMant = kBits[ 0 ] & ( ( uint64_t( 1 ) << 52 ) - 1 );
+					const uint64_t kExp = expo != 0 ? uint64_t( ( ( kBits[ 1 ] & 0xFFFFFFFF ) * uint64_t( expo ) ) >> 32 ) - expo / 2 + 0x3ff : 0x3ff;
+
+					uint64_t sign {};
+					if( pflag == 2 || pflag == 3 )
+						sign = kBits[ 0 ] >> 63;		//pflag=2, random data
+					else if( pflag == 1 )
+						sign = 1;						//pflag=1, well-conditioned data
 					else
-					{
-						ret=ret_saved;
-						((str_double*)(&ret))->sign=0;
-						rflag=0;
-					}
+						sign = i % 2 == 0;
+
+					const uint64_t kRet = ( sign << 63 ) | ( ( kExp & 0x7ff ) << 52 ) | kMant;
+					double ret {};
+					std::memcpy( & ret, & kRet, sizeof( ret ) );
 					return ret;
 				}
 
 
-				void Generate( DVec & inVec, int deltaExp, int _pFlag )
+				void Generate( double * original_list, const size_t MAXNUM, int deltaExp, int _pFlag )
 				{
 					assert( _pFlag >= 1 && _pFlag <= 4 );		// inherited from 908
 					pflag = _pFlag;
 
-					int MAXNUM = inVec.size();
+					if( MAXNUM == 0 )
+						return;
 
+					const Philox4x32	rng( fSeed );
 
-					srand((unsigned)time(NULL));
-					int i;
+					ThreadPool & pool = GetThreadPool();
 
-					double *original_list = & inVec[ 0 ];
+					// The blocks are fixed, so are the partial sums
+					// - the results do not depend on the number of threads
+					const size_t kBlocks = ( MAXNUM + kBlockSize - 1 ) / kBlockSize;
+
+					std::vector< std::future< double > >	block_sums;
+					for( size_t b = 0; b < kBlocks; ++ b )
+						block_sums.push_back( pool.Submit( [ this, & rng, original_list, MAXNUM, deltaExp ] ( size_t from )
+										{
+											const size_t kTo = std::min( from + kBlockSize, MAXNUM );
+											double st {};
+											for( size_t i = from; i < kTo; ++ i )
+											{
+												const double x = Rand( rng, i, deltaExp );
+												original_list[ i ] = x;
+												st += x;
+											}
+											return st;
+										}, b * kBlockSize ) );
 
 					double st=0;
-	
+					for( auto & f : block_sums )
+						st += pool.Get( f );
 
 
-					for(i=0;i<MAXNUM;i++)
+					// Anderson's ill-conditioned data
+					if( pflag == 3 )
 					{
-						original_list[i]=(Rand(deltaExp));
-						st+=original_list[i];
+						const double kMean = st / MAXNUM;
+
+						std::vector< std::future< void > >	blocks;
+						for( size_t b = 0; b < kBlocks; ++ b )
+							blocks.push_back( pool.Submit( [ original_list, MAXNUM, kMean ] ( size_t from )
+										{
+											const size_t kTo = std::min( from + kBlockSize, MAXNUM );
+											for( size_t i = from; i < kTo; ++ i )
+												original_list[ i ] -= kMean;
+										}, b * kBlockSize ) );
+						for( auto & f : blocks )
+							pool.Get( f );
 					}
 
-
-					// Anderson's ill-conditioned data
-					if(pflag==3) 
-						for(i=0;i<MAXNUM;i++)
-							original_list[i]-=st/MAXNUM;
-
 					//randomly change the order
-					for(i=0;i<MAXNUM*2;i++)
-					{
-						int x=rand()%MAXNUM;
-						int y=rand()%MAXNUM;
-						while(x==y)
-							y=rand()%MAXNUM;
-						double temp=original_list[x];
-						original_list[x]=original_list[y];
-						original_list[y]=temp;
-					}
+					ParallelShuffle( original_list, MAXNUM, fSeed ^ ( ( uint64_t( pflag ) << 32 | uint32_t( deltaExp ) ) * 0x9E3779B97F4A7C15 ) );
+				}
+			};
 
+			// xxxxxxxxxxxxxxxxxxx
 
+			uint64_t	fSeed { kDefaultSeed };
 
+		public:
 
-				}
-			};
+			static constexpr uint64_t kDefaultSeed { 908 };
 
-			// xxxxxxxxxxxxxxxxxxx
+			// The same seed gives the same data sets, bit for bit,
+			// regardless of the number of threads
+			explicit FP_Test_DataSet_Generator( const uint64_t seed = kDefaultSeed ) : fSeed( seed ) {}
+
+			uint64_t GetSeed( void ) const { return fSeed; }
+			void SetSeed( const uint64_t seed ) { fSeed = seed; }
 
 		public:
 
 			// (1, well-conditioned; 2, random; 3, Anderson's; and
 			// 4, exact sum equals zero)
-			void Fill_Numerical_Data_No( int flag, DVec & inVec, ST num_of_data, int deltaExp = 10 )
+			// The data goes to num_of_data elements at data, e.g. of a NumaBuffer
+			void Fill_Numerical_Data_No( int flag, double * data, ST num_of_data, int deltaExp = 10 )
 			{
 				_908_sandbox	_908_obj;
+				_908_obj.fSeed = fSeed;
+				_908_obj.Generate( data, num_of_data, deltaExp, flag );
+			}
+
+			void Fill_Numerical_Data_No( int flag, DVec & inVec, ST num_of_data, int deltaExp = 10 )
+			{
 				inVec.resize( num_of_data );
-				_908_obj.Generate( inVec, deltaExp, flag );
+				Fill_Numerical_Data_No( flag, inVec.data(), num_of_data, deltaExp );
 			}
 
 
-			void Fill_Numerical_Data_MersenneUniform( DVec & inVec, ST num_of_data, DT kDataMag )
+			// Uniform in [-kDataMag,+kDataMag). Despite the name (kept for the data
+			// set of the paper, where it was the Mersenne twister) the element i is
+			// drawn from Philox, as a function of ( fSeed, stream, i ) only - so the
+			// same seed gives the same data; v and w take different streams.
+			void Fill_Numerical_Data_MersenneUniform( double * data, ST num_of_data, DT kDataMag, const uint64_t stream = 0 )
+			{
+				constexpr size_t kBlockSize { _908_sandbox::kBlockSize };
+
+				const Philox4x32	rng( fSeed );
+
+				ThreadPool & pool = GetThreadPool();
+
+				std::vector< std::future< void > >	blocks;
+				for( size_t from = 0; from < num_of_data; from += kBlockSize )
+					blocks.push_back( pool.Submit( [ & rng, data, num_of_data, kDataMag, stream, from ] ()
+									{
+										const size_t kTo = std::min( from + kBlockSize, num_of_data );
+										for( size_t i = from; i < kTo; ++ i )
+										{
+											// 53 random bits to [0,1), then to [-1,1)
+											const double kUnit = double( rng.Bits128( i, stream )[ 0 ] >> 11 ) * 0x1p-53;
+											data[ i ] = ( 2.0 * kUnit - 1.0 ) * kDataMag;
+										}
+									} ) );
+
+				for( auto & b : blocks )
+					pool.Get( b );
+			}
+
+			void Fill_Numerical_Data_MersenneUniform( DVec & inVec, ST num_of_data, DT kDataMag, const uint64_t stream = 0 )
 			{
 				inVec.resize( num_of_data );
-				assert( inVec.size() == num_of_data );
-				mt19937		rand_gen{ random_device{}() };	// Random Mersenne twister
-				uniform_real_distribution< double > dist( - kDataMag, + kDataMag );
-				std::generate( inVec.begin(), inVec.end(), [&](){ return dist( rand_gen ); } );
+				Fill_Numerical_Data_MersenneUniform( inVec.data(), num_of_data, kDataMag, stream );
+			}
+
+			// The kElems elements at data, times multFactor, go after them
+			void Duplicate( double * data, ST kElems, DT multFactor = 1.0 )
+			{
+				std::transform( data, data + kElems, data + kElems, [ multFactor ] ( double x ) { return multFactor * x; } );
 			}
 
-			// 
 			void Duplicate( DVec & inVec, DT multFactor = 1.0 )
 			{
 				ST kElems { inVec.size() };
 				inVec.resize( 2 * kElems );
-				std::generate( inVec.begin() + kElems, inVec.end(), [ n = 0, & inVec, multFactor ] () mutable { return multFactor * inVec[ n ++ ]; } );
+				Duplicate( inVec.data(), kElems, multFactor );
 			}
 
 			void DuplicateWithNegated( DVec & inVec )
@@ -225,25 +289,73 @@ namespace InnerProducts
 namespace InnerProducts
 {
 
-	auto InnerProduct_StdAlg( const DVec & v, const DVec & w )
+	// If res is not null, each engine also puts there its value with the
+	// a-posteriori error bound and the condition number (see ErrorBound.h);
+	// the sum | v[ i ] * w[ i ] | goes along in the same pass over the data.
+	// The engines templated on T take the data of double or float; the float
+	// data is widened element by element, with no converted copies, and A
+	// (if given) is the type of the accumulation - double by default.
+	template < typename A = DT, typename T >
+	double InnerProduct_StdAlg( const BasicDataView< T > & v, const BasicDataView< T > & w, InnerProductResult * res = nullptr )
 	{
+		auto mult = [] ( const T a, const T b ) { return A( a ) * A( b ); };
+
 		// The last argument is an initial value
-		return std::inner_product( v.begin(), v.end(), w.begin(), DT() );
+		if( res == nullptr )
+			return std::inner_product( v.begin(), v.end(), w.begin(), A(), std::plus<>(), mult );
+
+		// The same order of the additions, with sum | v[ i ] * w[ i ] | next to it
+		const ST kElems = std::min( v.size(), w.size() );
+
+		A theSum {};
+		DT abs_sum {};
+		for( ST i = 0; i < kElems; ++ i )
+		{
+			const A p = mult( v[ i ], w[ i ] );
+			theSum += p;
+			abs_sum += std::fabs( p );
+		}
+
+		// The products and the additions are rounded in A
+		abs_sum = AbsSumBound( abs_sum, kElems );
+		* res = MakeInnerProductResult( theSum, abs_sum, RecursiveSumErrorBound( kElems, abs_sum, UnitRoundoff< A >() ) );
+		return theSum;
 	}
 
 
 	// The transform-reduce parallel version
-	auto InnerProduct_TR_Alg( const DVec & v, const DVec & w )
+	template < typename T >
+	double InnerProduct_TR_Alg( const BasicDataView< T > & v, const BasicDataView< T > & w, InnerProductResult * res = nullptr )
 	{
-		return std::transform_reduce(	std::execution::par,
-										v.begin(), v.end(), w.begin(), DT(),
-										[] ( const auto a, const auto b ) { return a + b; },
-										[] ( const auto a, const auto b ) { return a * b; }
+		if( res == nullptr )
+			return std::transform_reduce(	std::execution::par,
+											v.begin(), v.end(), w.begin(), DT(),
+											[] ( const auto a, const auto b ) { return a + b; },
+											[] ( const T a, const T b ) { return DT( a ) * DT( b ); }
+				);
+
+		// The products and their | values | are reduced together;
+		// the order of the reduction does not matter to the bound
+		struct Sums
+		{
+			DT	fSum {};
+			DT	fAbs {};
+		};
+
+		const Sums kSums = std::transform_reduce(	std::execution::par,
+													v.begin(), v.end(), w.begin(), Sums(),
+													[] ( const Sums & a, const Sums & b ) { return Sums { a.fSum + b.fSum, a.fAbs + b.fAbs }; },
+													[] ( const T a, const T b ) { const DT p = DT( a ) * DT( b ); return Sums { p, std::fabs( p ) }; }
 			);
+
+		const ST kElems = v.size();
+		const DT kAbsSum = AbsSumBound( kSums.fAbs, kElems );
+		* res = MakeInnerProductResult( kSums.fSum, kAbsSum, RecursiveSumErrorBound( kElems, kAbsSum ) );
+		return kSums.fSum;
 	}
 
 
-	auto InnerProduct_SortAlg( const DVec & v, const DVec & w )
+	auto InnerProduct_SortAlg( const DView & v, const DView & w, InnerProductResult * res = nullptr )
 	{
 		DVec z( std::min( v.size(), w.size() ) );		// Stores element-wise products
 
@@ -254,10 +366,23 @@ namespace InnerProducts
 					[] ( const auto & v_el, const auto & w_el) { return v_el * w_el; } );
 
 		// Sort in descending order.
-		std::sort( z.begin(), z.end(), [] ( const DT & p, const DT & q ) { return fabs( p ) < fabs( q ); } );		// Is it magic?
+		RadixSortByMagnitude( z );		// Sort by magnitude in O(n) - is it magic?
 
 		// The last argument is an initial value
-		return accumulate( z.begin(), z.end(), DT() );
+		if( res == nullptr )
+			return accumulate( z.begin(), z.end(), DT() );
+
+		// The same sum, with sum | z[ i ] | next to it
+		DT theSum {}, abs_sum {};
+		for( const auto p : z )
+		{
+			theSum += p;
+			abs_sum += std::fabs( p );
+		}
+
+		abs_sum = AbsSumBound( abs_sum, z.size() );
+		* res = MakeInnerProductResult( theSum, abs_sum, RecursiveSumErrorBound( z.size(), abs_sum ) );
+		return theSum;
 	}
 
 
@@ -266,7 +391,7 @@ namespace InnerProducts
 	{
 		// Having sort we need to apply a SERIAL accumulate to have GOOD results.
 		// This happens because std::reduce will brake the order. Simple.
-		std::sort( std::execution::par, v.begin(), v.end(), [] ( const DT & p, const DT & q ) { return fabs( p ) < fabs( q ); } );		// Is it magic?																																		
+		RadixSortByMagnitude( v );		// Sort by magnitude in O(n), in parallel
 		return accumulate( v.begin(), v.end(), DT() );		// This is IMPORTANT - we can sort in PARALLEL, but then we must accumulate in SERIAL (not to spoil the order)
 	}
 
@@ -277,9 +402,11 @@ namespace InnerProducts
 	// factor. In this algorithm the non associativity of FP is used, i.e.:
 	// ( a + b ) + c != a + ( b + c )
 	// v will be changed
-	auto Kahan_Sum( DVec & v )
+	// If res is not null, the rounded products in v are bounded (see KahanErrorBound).
+	auto Kahan_Sum( DVec & v, InnerProductResult * res = nullptr )
 	{
 		DT theSum {};
+		DT abs_sum {};
 
 		// volatile prevents a compiler from applying any optimization
 		// on the object since it can be changed by someone else, etc.,
@@ -289,6 +416,9 @@ namespace InnerProducts
 
 		for( ST i = 0; i < v.size(); ++ i )
 		{
+			if( res != nullptr )
+				abs_sum += std::fabs( v[ i ] );
+
 			DT y = v[ i ] - c;			// From the summand y subtract the correction factor
 
 			DT t = theSum + y;			// Add corrected summand to the running sum, i.e. theSum
@@ -301,6 +431,12 @@ namespace InnerProducts
 			theSum = t;
 		}
 
+		if( res != nullptr )
+		{
+			abs_sum = AbsSumBound( abs_sum, v.size() );
+			* res = MakeInnerProductResult( theSum, abs_sum, KahanErrorBound( v.size(), 1, theSum, abs_sum ) );
+		}
+
 		return theSum;
 	}
 
@@ -312,10 +448,10 @@ namespace InnerProducts
 	// factor. In this algorithm the non associativity of FP is used, i.e.:
 	// ( a + b ) + c != a + ( b + c )
 	// v will be changed
-	auto Kahan_Sort_And_Sum( DVec & v )
+	auto Kahan_Sort_And_Sum( DVec & v, InnerProductResult * res = nullptr )
 	{
-		std::sort( std::execution::par, v.begin(), v.end(), [] ( const DT & p, const DT & q ) { return fabs( p ) < fabs( q ); } );		// Is it magic?
-		return Kahan_Sum( v );
+		RadixSortByMagnitude( v );		// Sort by magnitude in O(n), in parallel
+		return Kahan_Sum( v, res );
 	}
 
 
@@ -324,9 +460,11 @@ namespace InnerProducts
 	// In the Kahan algorithm each addition is corrected by a correction
 	// factor. In this algorithm the non associativity of FP is used, i.e.:
 	// ( a + b ) + c != a + ( b + c )
-	auto InnerProduct_KahanAlg( const DVec & v, const DVec & w )
+	template < typename T >
+	auto InnerProduct_KahanAlg( const T * v, const T * w, const size_t kElems, InnerProductResult * res = nullptr )
 	{
 		DT theSum {};
+		DT abs_sum {};
 
 		// volatile prevents a compiler from applying any optimization
 		// on the object since it can be changed by someone else, etc.,
@@ -334,11 +472,14 @@ namespace InnerProducts
 
 		volatile DT c {};		// a "correction" coefficient
 
-		const ST kElems = std::min( v.size(), w.size() );
 
 		for( ST i = 0; i < kElems; ++ i )
 		{
-			DT y = v[ i ] * w[ i ] - c;	// From the summand y subtract the correction factor
+			const DT p = DT( v[ i ] ) * DT( w[ i ] );
+			if( res != nullptr )
+				abs_sum += std::fabs( p );
+
+			DT y = p - c;				// From the summand y subtract the correction factor
 
 			DT t = theSum + y;			// Add corrected summand to the running sum, i.e. theSum
 										// But theSum is bit, y is small, so its lower bits will be lost
@@ -350,37 +491,36 @@ namespace InnerProducts
 			theSum = t;
 		}
 
+		if( res != nullptr )
+		{
+			abs_sum = AbsSumBound( abs_sum, kElems );
+			* res = MakeInnerProductResult( theSum, abs_sum, KahanErrorBound( kElems, 1, theSum, abs_sum ) );
+		}
+
 		return theSum;
 	}
 
 
-	// Other version of the Kahan algorithms
-	auto InnerProduct_KahanAlg( const double * v, const double * w, const size_t kElems )
+	template < typename T >
+	auto InnerProduct_KahanAlg( const BasicDataView< T > & v, const BasicDataView< T > & w, InnerProductResult * res = nullptr )
 	{
-		DT theSum {};
-
-		// volatile prevents a compiler from applying any optimization
-		// on the object since it can be changed by someone else, etc.,
-		// in a way that cannot be foreseen by the compiler.
-
-		volatile DT c {};		// a "correction" coefficient
-
+		return InnerProduct_KahanAlg( v.data(), w.data(), std::min( v.size(), w.size() ), res );
+	}
 
-		for( ST i = 0; i < kElems; ++ i )
-		{
-			DT y = v[ i ] * w[ i ] - c;	// From the summand y subtract the correction factor
 
-			DT t = theSum + y;			// Add corrected summand to the running sum, i.e. theSum
-										// But theSum is bit, y is small, so its lower bits will be lost
+	// The multi-lane (SIMD) version of the Kahan algorithm,
+	// see InnerProductSIMD.h
+	template < typename T >
+	auto InnerProduct_KahanAlg_SIMD( const BasicDataView< T > & v, const BasicDataView< T > & w, InnerProductResult * res = nullptr )
+	{
+		const auto kElems { std::min( v.size(), w.size() ) };
 
-			c = ( t - theSum ) - y;		// Low order bits of y are lost in the summation. High order
-										// bits of y are computed in ( t - theSum ). Then, when y
-										// is subtracted from this, the low order bits of y are recovered (negative).
-										// Algebraically, c should always be 0 (beware of compiler optimization).
-			theSum = t;
-		}
+		if( res == nullptr )
+			return InnerProduct_KahanAlg_SIMD( v.data(), w.data(), kElems );
 
-		return theSum;
+		// The bound and the condition number from the same loop
+		* res = InnerProduct_KahanAlg_SIMD_Bounded( v.data(), w.data(), kElems );
+		return res->fValue;
 	}
 
 
@@ -388,7 +528,7 @@ namespace InnerProducts
 
 
 	// Test the two
-	auto InnerProduct_Sort_KahanAlg( const DVec & v, const DVec & w )
+	auto InnerProduct_Sort_KahanAlg( const DView & v, const DView & w, InnerProductResult * res = nullptr )
 	{
 		DVec z( std::min( v.size(), w.size() ) );		// Stores element-wise products
 
@@ -398,85 +538,292 @@ namespace InnerProducts
 					[] ( const auto & v_el, const auto & w_el) { return v_el * w_el; } );
 
 
-		std::sort( std::execution::par, z.begin(), z.end(), [] ( const DT & p, const DT & q ) { return fabs( p ) < fabs( q ); } );		// Is it magic?
+		RadixSortByMagnitude( z );		// Sort by magnitude in O(n), in parallel
 
 		// ------------------------
 
+		return Kahan_Sum( z, res );
+	}
+	
 
 
-		DT theSum {};
+	
+	// 2nd version
+	auto InnerProduct_Sort_KahanAlg(  const double * v, const double * w, const size_t kElems, InnerProductResult * res = nullptr  )
+	{
+		DVec z;		// Stores element-wise products
+		z.reserve( kElems );
+
+		// Elementwise multiplication: c = a .* b
+		transform(	v, v + kElems, w, 
+					back_inserter( z ), 
+					[] ( const auto & v_el, const auto & w_el) { return v_el * w_el; } );
+
+		RadixSortByMagnitude( z );		// Sort by magnitude in O(n) - is it magic?
+
+		// ------------------------
+
+		return Kahan_Sum( z, res );
+	}
 
-		// volatile prevents a compiler from applying any optimization
-		// on the object since it can be changed by someone else, etc.,
-		// in a way that cannot be foreseen by the compiler.
 
-		volatile DT c {};		// a "correction" factor
 
-		const ST kElems = z.size();
+	// Sort-free alternative to the above. The sort is needed only to sum up
+	// the products in roughly ascending magnitude, so here the products
+	// are just binned by their IEEE exponent (in one streaming pass) and
+	// each bin is summed with TwoSum (the errors go to a second bin).
+	// Then the bins are combined from the smallest to the largest exponent
+	// with the compensated summation. This is O(n) with no extra memory
+	// but for the 2 x 2048 bins, which fit into L1.
+	// The bound is that of Kahan: the products are rounded (u S), the errors
+	// of a bin are added up recursively (below gamma_n^2 S) and the bins go
+	// through the compensated summation of 2 x 2048 terms.
+	auto InnerProduct_ExpBucket_KahanAlg( const double * v, const double * w, const size_t kElems, InnerProductResult * res = nullptr )
+	{
+		constexpr size_t kBins { 2048 };		// number of exponents of double
+
+		DT hi[ kBins ] {};		// sums of the products of the given exponent
+		DT lo[ kBins ] {};		// and their rounding errors
+
+		DT abs_sum {};
 
 		for( ST i = 0; i < kElems; ++ i )
 		{
-			DT y = z[ i ] - c;	// From the summand y subtract the correction factor
+			const DT p = v[ i ] * w[ i ];
+			if( res != nullptr )
+				abs_sum += std::fabs( p );
 
-			DT t = theSum + y;			// Add corrected summand to the running sum, i.e. theSum
-										// But theSum is bit, y is small, so its lower bits will be lost
+			str_double sd;
+			std::memcpy( & sd, & p, sizeof( sd ) );
 
-			c = ( t - theSum ) - y;		// Low order bits of y are lost in the summation. High order
-										// bits of y are computed in ( t - theSum ). Then, when y
-										// is subtracted from this, the low order bits of y are recovered (negative).
-										// Algebraically, c should always be 0 (beware of compiler optimization).
-			theSum = t;
+			DT e {};
+			TwoSum( hi[ sd.exponent ], p, hi[ sd.exponent ], e );
+			lo[ sd.exponent ] += e;
 		}
 
-		return theSum;
+		CompensatedSum	theSum;
+		for( size_t b = 0; b < kBins; ++ b )
+			if( hi[ b ] != 0.0 || lo[ b ] != 0.0 )
+				theSum.Add( CompensatedSum { hi[ b ], lo[ b ] } );
+
+		const DT kValue = theSum.Value();
+
+		if( res != nullptr )
+		{
+			abs_sum = AbsSumBound( abs_sum, kElems );
+			* res = MakeInnerProductResult( kValue, abs_sum, KahanErrorBound( kElems, kBins, kValue, abs_sum ) );
+		}
+
+		return kValue;
 	}
-	
 
 
-	
-	// 2nd version
-	auto InnerProduct_Sort_KahanAlg(  const double * v, const double * w, const size_t kElems  )
+	auto InnerProduct_ExpBucket_KahanAlg( const DView & v, const DView & w, InnerProductResult * res = nullptr )
 	{
-		DVec z;		// Stores element-wise products
+		return InnerProduct_ExpBucket_KahanAlg( v.data(), w.data(), std::min( v.size(), w.size() ), res );
+	}
 
-		// Elementwise multiplication: c = a .* b
-		transform(	v, v + kElems, w, 
-					back_inserter( z ), 
-					[] ( const auto & v_el, const auto & w_el) { return v_el * w_el; } );
 
-		std::sort( z.begin(), z.end(), [] ( const DT & p, const DT & q ) { return fabs( p ) < fabs( q ); } );		// Is it magic?
 
-		// ------------------------
 
+	//////////////
 
 
-		DT theSum {};
+	// The Dot2 algorithm by Ogita, Rump and Oishi.
+	// Contrary to the above, the rounding error of each product is not lost -
+	// it is computed exactly with FMA (TwoProduct) and, together with
+	// the error of the addition (TwoSum), goes to the correction term.
+	// The result is as accurate as if computed in twice the working precision.
+	// The products of float data are exact in double, so there is no TwoProduct for it.
+	template < typename T >
+	auto InnerProduct_Dot2( const T * v, const T * w, const size_t kElems, InnerProductResult * res = nullptr )
+	{
+		double p {};		// the running sum
+		double s {};		// the sum of all errors
 
-		// volatile prevents a compiler from applying any optimization
-		// on the object since it can be changed by someone else, etc.,
-		// in a way that cannot be foreseen by the compiler.
+		double abs_sum {};
+
+		for( ST i = 0; i < kElems; ++ i )
+		{
+			double h {}, h_err {}, t_err {};
 
-		volatile DT c {};		// a "correction" factor
+			if constexpr( kExactProduct< T > )
+				h = double( v[ i ] ) * double( w[ i ] );
+			else
+				TwoProduct( v[ i ], w[ i ], h, h_err );
+			TwoSum( p, h, p, t_err );
 
+			s += t_err + h_err;
+
+			if( res != nullptr )
+				abs_sum += std::fabs( h );
+		}
 
-		for( ST i = 0; i < z.size(); ++ i )
+		if( res != nullptr )
 		{
-			DT y = z[ i ] - c;	// From the summand y subtract the correction factor
+			abs_sum = AbsSumBound( abs_sum, kElems );
+			* res = MakeInnerProductResult( p + s, abs_sum, Dot2ErrorBound( kElems, 1, p + s, abs_sum ) );
+		}
 
-			DT t = theSum + y;			// Add corrected summand to the running sum, i.e. theSum
-										// But theSum is bit, y is small, so its lower bits will be lost
+		return p + s;
+	}
 
-			c = ( t - theSum ) - y;		// Low order bits of y are lost in the summation. High order
-										// bits of y are computed in ( t - theSum ). Then, when y
-										// is subtracted from this, the low order bits of y are recovered (negative).
-										// Algebraically, c should always be 0 (beware of compiler optimization).
-			theSum = t;
+
+	template < typename T >
+	auto InnerProduct_Dot2( const BasicDataView< T > & v, const BasicDataView< T > & w, InnerProductResult * res = nullptr )
+	{
+		return InnerProduct_Dot2( v.data(), w.data(), std::min( v.size(), w.size() ), res );
+	}
+
+
+	template < typename T >
+	auto InnerProduct_Dot2_SIMD( const BasicDataView< T > & v, const BasicDataView< T > & w, InnerProductResult * res = nullptr )
+	{
+		const auto kElems { std::min( v.size(), w.size() ) };
+
+		if( res == nullptr )
+			return InnerProduct_Dot2_SIMD( v.data(), w.data(), kElems );
+
+		// The bound and the condition number from the same loop
+		* res = InnerProduct_Dot2_SIMD_Bounded( v.data(), w.data(), kElems );
+		return res->fValue;
+	}
+
+
+	// The K-fold version of Dot2 (DotK of Ogita, Rump and Oishi, Algorithm 5.10).
+	// TwoProduct and the TwoSum of the running sum turn the inner product into
+	// the 2 n terms of the same exact sum (its products' errors, the errors of the
+	// additions and the sum itself), then K - 2 distillation passes (VecSum) go
+	// over them before the final recursive sum; K == 2 is Dot2. The result is
+	// as accurate as if computed in K-fold working precision and then rounded:
+	//		| res - v'w | <= ( u + 2 gamma_4n^2 ) | v'w | + gamma_4n^K sum | v[ i ] w[ i ] |
+	// (Proposition 5.11 there). It needs 2 n doubles of the scratch memory.
+	// It is registered as Dot3 and Dot4.
+	template < int K >
+	auto InnerProduct_DotK( const double * v, const double * w, const size_t kElems, InnerProductResult * res = nullptr )
+	{
+		static_assert( K >= 2 );
+
+		if( kElems == 0 )
+		{
+			if( res != nullptr )
+				* res = MakeInnerProductResult( 0.0, 0.0, 0.0 );
+			return 0.0;
 		}
 
-		return theSum;
+		const size_t kTerms { 2 * kElems };
+		DVec	r( kTerms );
+
+		double p {};
+		TwoProduct( v[ 0 ], w[ 0 ], p, r[ 0 ] );
+		double abs_sum { std::fabs( p ) };
+		for( ST i = 1; i < kElems; ++ i )
+		{
+			double h {};
+			TwoProduct( v[ i ], w[ i ], h, r[ i ] );
+			TwoSum( p, h, p, r[ kElems + i - 1 ] );
+			abs_sum += std::fabs( h );
+		}
+		r[ kTerms - 1 ] = p;
+
+		// VecSum - the same sum, with the larger part moved up to the last term
+		for( int k = 0; k < K - 2; ++ k )
+			for( ST i = 1; i < kTerms; ++ i )
+				TwoSum( r[ i ], r[ i - 1 ], r[ i ], r[ i - 1 ] );
+
+		double theSum {};
+		for( ST i = 0; i + 1 < kTerms; ++ i )
+			theSum += r[ i ];
+
+		const double kValue { theSum + r[ kTerms - 1 ] };
+
+		if( res != nullptr )
+		{
+			// | v'w | <= | res | + the error
+			abs_sum = AbsSumBound( abs_sum, kElems );
+			const double kG = Gamma( 4 * kElems );
+			const double kRel = UnitRoundoff< double >() + 2.0 * kG * kG;
+			* res = MakeInnerProductResult( kValue, abs_sum, ( kRel * std::fabs( kValue ) + std::pow( kG, K ) * abs_sum ) / ( 1.0 - kRel ) );
+		}
+
+		return kValue;
+	}
+
+
+	template < int K >
+	auto InnerProduct_DotK( const DView & v, const DView & w, InnerProductResult * res = nullptr )
+	{
+		return InnerProduct_DotK< K >( v.data(), w.data(), std::min( v.size(), w.size() ), res );
+	}
+
+
+	// The double-double and quad-double inner products (106 and 212 bits),
+	// see MultiDouble.h - a fast alternative to ttmath where these are enough
+	auto InnerProduct_DoubleDouble( const DView & v, const DView & w, InnerProductResult * res = nullptr )
+	{
+		const auto kElems { std::min( v.size(), w.size() ) };
+
+		if( res == nullptr )
+			return InnerProduct_DoubleDouble( v.data(), w.data(), kElems ).ToDouble();
+
+		double abs_sum {};
+		const double kValue = InnerProduct_DoubleDouble( v.data(), w.data(), kElems, abs_sum ).ToDouble();
+		abs_sum = AbsSumBound( abs_sum, kElems );
+		* res = MakeInnerProductResult( kValue, abs_sum, DoubleDoubleErrorBound( kElems, kValue, abs_sum ) );
+		return kValue;
+	}
+
+
+	template < typename T >
+	auto InnerProduct_DoubleDouble_SIMD( const BasicDataView< T > & v, const BasicDataView< T > & w, InnerProductResult * res = nullptr )
+	{
+		const auto kElems { std::min( v.size(), w.size() ) };
+
+		if( res == nullptr )
+			return InnerProduct_DoubleDouble_SIMD( v.data(), w.data(), kElems );
+
+		* res = InnerProduct_DoubleDouble_SIMD_Bounded( v.data(), w.data(), kElems );
+		return res->fValue;
+	}
+
+
+	// There is no rigorous bound of the quad-double sum (see MultiDouble.h),
+	// so it is infinite - but the condition number comes with the value
+	auto InnerProduct_QuadDouble( const DView & v, const DView & w, InnerProductResult * res = nullptr )
+	{
+		const auto kElems { std::min( v.size(), w.size() ) };
+
+		if( res == nullptr )
+			return InnerProduct_QuadDouble( v.data(), w.data(), kElems ).ToDouble();
+
+		double abs_sum {};
+		const double kValue = InnerProduct_QuadDouble( v.data(), w.data(), kElems, abs_sum ).ToDouble();
+		* res = MakeInnerProductResult( kValue, AbsSumBound( abs_sum, kElems ), std::numeric_limits< double >::infinity() );
+		return kValue;
 	}
 
 
+	// The exact inner product - all products are accumulated exactly
+	// in the long fixed-point accumulator and rounded only once
+	// (so it errs by at most u of itself).
+	auto InnerProduct_LongAcc( const DView & v, const DView & w, InnerProductResult * res = nullptr )
+	{
+		const auto kElems { std::min( v.size(), w.size() ) };
+
+		LongAccumulator		theSum;
+		double				abs_sum {};
+		if( res == nullptr )
+			theSum.AddProducts( v.data(), w.data(), kElems );
+		else
+			theSum.AddProducts( v.data(), w.data(), kElems, abs_sum );
+
+		const double kValue = theSum.GetSum();
+
+		if( res != nullptr )
+			* res = MakeInnerProductResult( kValue, AbsSumBound( abs_sum, kElems ), UnitRoundoff< double >() * std::fabs( kValue ) );
+
+		return kValue;
+	}
 
 
 	//////////////
@@ -492,7 +839,7 @@ namespace InnerProducts
 
 		using InnerProducts::DVec;
 
-		auto InnerProduct_BNum( const DVec & v, const DVec & w )
+		auto InnerProduct_BNum( const DView & v, const DView & w )
 		{
 			// The last argument is an initial value
 			//return std::inner_product( v.begin(), v.end(), w.begin(), DT() );
@@ -531,8 +878,6 @@ namespace InnerProducts
 		{
 			DVec z;		// Stores element-wise products
 
-			z.push_back( 0.0 );		// we need that since the guy is starting from index 1, well...
-
 			z.push_back( 1 );
 			z.push_back( 2 );
 			z.push_back( 3 );
@@ -546,19 +891,14 @@ namespace InnerProducts
 
 			mysum.Reset();
 
-			return mysum.OnlineExactSum( & z[ 1 ], z.size() - 1 );
+			return mysum.OnlineExactSum( z );		// the 0-based view, no padding needed
 		}
 
 	
-		auto InnerProduct_908( const DVec & v, const DVec & w )
+		auto InnerProduct_908( const DView & v, const DView & w )
 		{
-			assert( false );			// something is wrong here
-
-
 			DVec z;		// Stores element-wise products
 
-			z.push_back( 0.0 );		// we need that since the guy is starting from index 1, well...
-
 			// Elementwise multiplication: c = a .* b
 			// Add parallelization to transform
 			transform(	v.begin(), v.end(), w.begin(), 
@@ -569,54 +909,72 @@ namespace InnerProducts
 
 			mysum.Reset();
 
-			return mysum.OnlineExactSum( & z[ 1 ], z.size() - 1 );
+			return mysum.OnlineExactSum( z );
 		}
 
 
-		auto Sum_908( const DVec & v )
+		auto Sum_908( const DView & v )
 		{
 			ExactSum mysum;
 
 			mysum.Reset();
 
-			for( auto x : v )
-				mysum.AddNumber( x );
+			mysum.AddArray( v );
 			
 			return mysum.GetSum();
 		}
-		auto InnerProduct_908_b( const DVec & v, const DVec & w )
+		// The products are rounded, then summed exactly and rounded once,
+		// so the bound in res is u S + u | value |.
+		auto InnerProduct_908_b( const DView & v, const DView & w, InnerProductResult * res = nullptr )
 		{
 			ExactSum mysum;
 
 			mysum.Reset();
 
+			double abs_sum {};
+
 			const auto kSize { std::min( v.size(), w.size() ) };
 			for( auto i : range( kSize ) )
-				mysum.AddNumber( v[ i ] * w[ i ] );
+			{
+				const double p = v[ i ] * w[ i ];
+				if( res != nullptr )
+					abs_sum += std::fabs( p );
+				mysum.AddNumber( p );
+			}
 			
-			return mysum.GetSum();
-		}
+			const double kValue = mysum.GetSum();
 
+			if( res != nullptr )
+			{
+				abs_sum = AbsSumBound( abs_sum, kSize );
+				* res = MakeInnerProductResult( kValue, abs_sum, UnitRoundoff< double >() * ( abs_sum + std::fabs( kValue ) ) );
+			}
 
-		auto InnerProduct_908_c( const DVec & v, const DVec & w )
-		{
-			DVec z( v.size() );		// Stores element-wise products
+			return kValue;
+		}
 
-			z.push_back( 0.0 );		// we need that since the guy is starting from index 1, well...
 
-			// Elementwise multiplication: c = a .* b
-			// Add parallelization to transform
-			transform(	v.begin(), v.end(), w.begin(), 
-						z.begin() + 1, 
-						[] ( const auto & v_el, const auto & w_el) { return v_el * w_el; } );
-	
+		// No temporary vector of the products anymore - AddProducts bins
+		// the rounded products together with their exact rounding errors,
+		// so this one returns the correctly rounded exact inner product
+		// (within u of itself).
+		auto InnerProduct_908_c( const DView & v, const DView & w, InnerProductResult * res = nullptr )
+		{
 			ExactSum mysum;
 
 			mysum.Reset();
 
-			mysum.AddArray( & z[ 0 ], v.size() );
+			const auto kSize { std::min( v.size(), w.size() ) };
+
+			double abs_sum {};
+			mysum.AddProducts( v.data(), w.data(), kSize, res != nullptr ? & abs_sum : nullptr );
 
-			return mysum.GetSum();
+			const double kValue = mysum.GetSum();
+
+			if( res != nullptr )
+				* res = MakeInnerProductResult( kValue, AbsSumBound( abs_sum, kSize ), UnitRoundoff< double >() * std::fabs( kValue ) );
+
+			return kValue;
 		}
 
 		auto InnerProduct_908_par( const double * v, const double * w, const size_t kElems )
@@ -624,8 +982,7 @@ namespace InnerProducts
 			ExactSum mysum;
 			mysum.Reset();
 
-			for( auto i : range( kElems ) )
-				mysum.AddNumber( v[ i ] * w[ i ] );
+			mysum.AddProducts( v, w, kElems );
 			
 			return mysum.GetSum();
 		}
@@ -636,306 +993,1179 @@ namespace InnerProducts
 	//////////////
 
 
+	///////////////////////////////////////////////////////////
+	// Runs fun on consecutive chunks of v and w in the thread pool
+	///////////////////////////////////////////////////////////
+	//
+	// INPUT:
+	//		v, w - pointers to the input data (of double or float)
+	//		kMinSize - number of elements to process
+	//		kChunkSize - number of elements in a chunk; the last
+	//			chunk gets the remainder, if present
+	//		fun - a serial kernel fun( a, b, n )
+	//		kThreads - at most this many workers run the chunks
+	//			(0, or the size of the pool, means all of them)
+	// OUTPUT:
+	//		vector of the partial results in the chunk order
+	//
+	// REMARKS:
+	//		The chunks become tasks of the persistent pool,
+	//		so there are no threads created per call and the
+	//		number of chunks does not depend on the number of cores.
+	//		If the pool is pinned, a chunk goes to the worker which
+	//		owns its block of the data (see BlockOwner in NumaSupport.h).
+	//		With fewer threads, each of the kThreads tasks takes
+	//		the next chunk from a shared counter until all are done -
+	//		or, if the pool is pinned, the chunks of its share of
+	//		the data, on a worker of that share.
+	//
+	template < typename T, typename F >
+	auto ChunkedPartials( const T * v, const T * w, const size_t kMinSize, const size_t kChunkSize, F fun, const size_t kThreads = 0 )
+	{
+		using R = std::invoke_result_t< F, const T *, const T *, size_t >;
+
+		assert( kChunkSize > 0 );
+
+		const size_t k_num_of_chunks { ( kMinSize / kChunkSize ) };
+		const size_t k_remainder { kMinSize % kChunkSize };
+
+		ThreadPool &	pool = GetThreadPool();
+
+		vector< R >		par_sum;
+
+		if( kThreads > 0 && kThreads < pool.size() )
+		{
+			const size_t kAllChunks { k_num_of_chunks + ( k_remainder > 0 ? 1 : 0 ) };
+
+			par_sum.resize( kAllChunks );
+
+			const size_t kRunners { std::min( kThreads, kAllChunks ) };
+
+			auto run_chunk = [ & ] ( size_t i ) { par_sum[ i ] = fun( v + i * kChunkSize, w + i * kChunkSize, i < k_num_of_chunks ? kChunkSize : k_remainder ); };
+
+			std::atomic< size_t >	next_chunk {};
+
+			vector< future< void > >	runners;
+			for( size_t t = 0; t < kRunners; ++ t )
+				if( pool.IsPinned() )
+				{
+					// The runner t takes the chunks of its share of the blocks (BlockOwner), on the
+					// worker which owns the start of the share - the workers go node by node
+					// (PinThreadPool), so the chunks are read from the nodes they were placed on
+					const size_t kWorker { BlockOwner( ( t * kMinSize + kRunners - 1 ) / kRunners, kMinSize, pool.size() ) };
+					runners.push_back( pool.SubmitTo( kWorker, [ &, t ] ()
+								{
+									for( size_t i = 0; i < kAllChunks; ++ i )
+										if( BlockOwner( i * kChunkSize, kMinSize, kRunners ) == t )
+											run_chunk( i );
+								} ) );
+				}
+				else
+				{
+					runners.push_back( pool.Submit( [ & ] ()
+								{
+									for( size_t i; ( i = next_chunk ++ ) < kAllChunks; )
+										run_chunk( i );
+								} ) );
+				}
+
+			for( auto & r : runners )
+				pool.Get( r );
+
+			return par_sum;
+		}
+
+		vector< future< R > >		chunk_futures;
+		chunk_futures.reserve( k_num_of_chunks + ( k_remainder > 0 ? 1 : 0 ) );
+
+		auto worker_of = [ & pool, kMinSize ] ( size_t i ) { return pool.IsPinned() ? BlockOwner( i, kMinSize, pool.size() ) : ThreadPool::kAnyWorker; };
+
+		// Process all equal size chunks of data
+		for( size_t i = 0; i < k_num_of_chunks; ++ i )
+			chunk_futures.push_back( pool.SubmitTo( worker_of( i * kChunkSize ), fun, v + i * kChunkSize, w + i * kChunkSize, kChunkSize ) );
+
+		// Process the ramainder, if present
+		if( k_remainder > 0 )
+			chunk_futures.push_back( pool.SubmitTo( worker_of( k_num_of_chunks * kChunkSize ), fun, v + k_num_of_chunks * kChunkSize, w + k_num_of_chunks * kChunkSize, k_remainder ) );
+
+		par_sum.reserve( chunk_futures.size() );
+		for( auto & f : chunk_futures )
+			par_sum.push_back( pool.Get( f ) );			// Get() bocks until the task is done
+
+		return par_sum;
+	}
+
+
+	///////////////////////////////////////////////////////////
+	// Merges the partial accumulators in the thread pool
+	///////////////////////////////////////////////////////////
+	//
+	// INPUT:
+	//		parts - the accumulators; T must provide Merge( const T & )
+	// OUTPUT:
+	//		the accumulator with all of the parts merged in (i.e. parts[ 0 ])
+	//
+	// REMARKS:
+	//		The merges are done pairwise in log2( parts.size() ) rounds,
+	//		the merges of a round run in parallel.
+	//
+	template < typename T >
+	T & TreeMerge( vector< unique_ptr< T > > & parts )
+	{
+		assert( parts.size() > 0 );
+
+		ThreadPool &	pool = GetThreadPool();
+
+		for( size_t stride = 1; stride < parts.size(); stride *= 2 )
+		{
+			vector< future< void > >		merges;
+
+			for( size_t i = 0; i + stride < parts.size(); i += 2 * stride )
+				merges.push_back( pool.Submit( [ & parts, i, stride ] () { parts[ i ]->Merge( * parts[ i + stride ] ); } ) );
+
+			for( auto & m : merges )
+				pool.Get( m );
+		}
+
+		return * parts[ 0 ];
+	}
+
+
+	// The name of a parallel kernel in the tuning profile (see AutoTune.h),
+	// which keeps the kernels of the float data apart from those of double
+	template < typename T >
+	std::string TunedName( const std::string & name )
+	{
+		return std::is_same_v< T, float > ? name + " of float" : name;
+	}
+
+
+	// The chunks which return the InnerProductResult are merged here: their values
+	// go through the sorted Kahan sum (which adds its own bound, see Kahan_Sum),
+	// the bounds of the chunks are added up with the rounding error of at most gamma_m.
+	// Returns the value; the merged bound and condition number go to res.
+	double MergeChunkResults( const vector< InnerProductResult > & parts, InnerProductResult & res )
+	{
+		DVec	values;
+		double	bound {}, abs_sum {};
+		for( const auto & p : parts )
+		{
+			values.push_back( p.fValue );
+			bound += p.fErrorBound;
+			abs_sum += p.fAbsSum;
+		}
+
+		InnerProductResult	merge;
+		const double kValue = Kahan_Sort_And_Sum( values, & merge );
+
+		bound = bound * ( 1.0 + Gamma( parts.size() + 1 ) ) + merge.fErrorBound;
+		res = MakeInnerProductResult( kValue, AbsSumBound( abs_sum, parts.size() ), bound );
+		return kValue;
+	}
+
+
 	// THE BEST PERFORMANCE
 	// This is a simple data paralellization of the Kahan algorithm.
 	// The input vectors are divided into the chunks which are 
-	// then processed in parallel but by the serial Kahan algorithm.
+	// then processed in parallel but by the multi-lane Kahan algorithm.
 	// The partial sums are then summed up with yet run of the
 	// Kahan algorithm.
-	auto InnerProduct_KahanAlg_Par( const DVec & v, const DVec & w, const ST kChunkSize = 10000 )
+	// The chunk size (and the number of threads) is tuned by default, see AutoTune.h.
+	// If res is not null, each chunk also returns its bound (see MergeChunkResults).
+	template < typename T >
+	auto InnerProduct_KahanAlg_Par( const BasicDataView< T > & v, const BasicDataView< T > & w, const ST kChunkSize = kAutoTune, InnerProductResult * res = nullptr )
 	{
 		const auto kMinSize { std::min( v.size(), w.size() ) };
 
-		const auto k_num_of_chunks { ( kMinSize / kChunkSize ) };
-		const auto k_remainder { kMinSize % kChunkSize };
+		// The thing is that we wish Kahan because it is much faster than the sort-accum
+		auto fun_inter = [ res ] ( const T * a, const T * b, size_t s ) 
+							{ 
+								InnerProductResult	part;
+								if( res != nullptr )
+									part = InnerProduct_KahanAlg_SIMD_Bounded( a, b, s );
+								else
+									part.fValue = InnerProduct_KahanAlg_SIMD( a, b, s );
+								return part;
+							};
+
+		return RunTuned( TunedName< T >( "Parallel Kahan" ), kMinSize, kChunkSize, [ & ] ( size_t chunk, size_t threads )
+							{
+								const auto par_sum = ChunkedPartials( v.data(), w.data(), kMinSize, chunk, fun_inter, threads );
+
+								if( res != nullptr )
+									return MergeChunkResults( par_sum, * res );
+
+								DVec	values;
+								for( const auto & ps : par_sum )
+									values.push_back( ps.fValue );
+
+								return Kahan_Sort_And_Sum( values );
+							} );
+	}
 
-		const double * v_data_begin = & v[ 0 ];
-		const double * w_data_begin = & w[ 0 ];
 
-		vector< double >	par_sum( k_num_of_chunks + ( k_remainder > 0 ? 1 : 0 ), 0.0 );	
+	auto InnerProduct_SortKahanAlg_Par( const DView & v, const DView & w, const size_t kChunkSize = kAutoTune, InnerProductResult * res = nullptr )
+	{
+		const auto kMinSize { std::min( v.size(), w.size() ) };
 
 		// The thing is that we wish Kahan because it is much faster than the sort-accum
-		auto fun_inter = [] ( const double * a, const double * b, int s ) { return InnerProduct_KahanAlg( a, b, s ); };
+		auto fun_inter = [ res ] ( const double * a, const double * b, size_t s ) 
+							{ 
+								InnerProductResult	part;
+								part.fValue = InnerProduct_Sort_KahanAlg( a, b, s, res != nullptr ? & part : nullptr );
+								return part;
+							};
+
+		return RunTuned( "Parallel Sort-Kahan", kMinSize, kChunkSize, [ & ] ( size_t chunk, size_t threads )
+							{
+								const auto par_sum = ChunkedPartials( v.data(), w.data(), kMinSize, chunk, fun_inter, threads );
+
+								if( res != nullptr )
+									return MergeChunkResults( par_sum, * res );
+
+								DVec	values;
+								for( const auto & ps : par_sum )
+									values.push_back( ps.fValue );
+
+								return Kahan_Sort_And_Sum( values );
+							} );
+	}
 
-		vector< future< double > >		my_thread_poool;
 
-		// Process all equal size chunks of data
-		std::decay< decltype( k_num_of_chunks ) >::type i {}; 
-		for( i = 0; i < k_num_of_chunks; ++ i )
-			my_thread_poool.push_back( async( std::launch::async, fun_inter, v_data_begin + i * kChunkSize, w_data_begin + i * kChunkSize, kChunkSize ) );
 
-		// Process the ramainder, if present
-		if( k_remainder > 0 )
-			my_thread_poool.push_back( async( std::launch::async, fun_inter, v_data_begin + i * kChunkSize, w_data_begin + i * kChunkSize, k_remainder ) );
 
-		assert( par_sum.size() == my_thread_poool.size() );
-		for( i = 0; i < my_thread_poool.size(); ++ i )
-			par_sum[ i ] = my_thread_poool[ i ].get();			// get() bocks until the async is done
+	// Each worker of the pool adds the products of its chunks to its own
+	// ExactSum. Then these are merged exactly (in parallel) and rounded
+	// only once, so the result is the same as for the serial 908
+	// (and errs by at most u of itself).
+	auto InnerProduct_908_Par( const DView & v, const DView & w, const size_t kChunkSize = kAutoTune, InnerProductResult * res = nullptr )
+	{
+		const auto kMinSize { std::min( v.size(), w.size() ) };
 
-		return Kahan_Sort_And_Sum( par_sum );			
+		ThreadPool &	pool = GetThreadPool();
+
+		return RunTuned( "Parallel 908", kMinSize, kChunkSize, [ & ] ( size_t chunk, size_t threads )
+							{
+								vector< unique_ptr< ExactSum > >	thread_sum;
+								for( size_t i = 0; i < pool.size(); ++ i )
+									thread_sum.push_back( make_unique< ExactSum >() );		// the constructor calls Reset()
+
+								// The lambda for serial summation - to the accumulator of the current worker;
+								// it returns the number of the products and the sum of their | values |
+								auto fun_inter = [ & thread_sum, & pool, res ] ( const double * a, const double * b, size_t s ) 
+													{ 
+														double abs_sum {};
+														thread_sum[ pool.WorkerIndex() ]->AddProducts( a, b, s, res != nullptr ? & abs_sum : nullptr );
+														return std::make_pair( s, abs_sum );
+													};
+
+								const auto par_cnt = ChunkedPartials( v.data(), w.data(), kMinSize, chunk, fun_inter, threads );
+
+								size_t	cnt {};
+								double	abs_sum {};
+								for( const auto & pc : par_cnt )
+								{
+									cnt += pc.first;
+									abs_sum += pc.second;
+								}
+								assert( cnt == kMinSize );
+
+								const double kValue = TreeMerge( thread_sum ).GetSum();
+
+								if( res != nullptr )
+									* res = MakeInnerProductResult( kValue, AbsSumBound( abs_sum, kMinSize + par_cnt.size() ), UnitRoundoff< double >() * std::fabs( kValue ) );
+
+								return kValue;
+							} );
 	}
 
 
-	auto InnerProduct_SortKahanAlg_Par( const DVec & v, const DVec & w, const size_t kChunkSize = 10000 )
+	// The chunked Dot2 - each chunk returns its unevaluated sum
+	// ( fHi, fLo ) and these are merged without losing the compensation,
+	// so it is Dot2 of all of the lanes of all of the chunks.
+	template < typename T >
+	auto InnerProduct_Dot2_Par( const BasicDataView< T > & v, const BasicDataView< T > & w, const size_t kChunkSize = kAutoTune, InnerProductResult * res = nullptr )
 	{
 		const auto kMinSize { std::min( v.size(), w.size() ) };
 
-		const auto k_num_of_chunks { ( kMinSize / kChunkSize ) };
-		const auto k_remainder { kMinSize % kChunkSize };
+		auto fun_inter = [ res ] ( const T * a, const T * b, size_t s ) 
+							{ 
+								double abs_sum {};
+								const CompensatedSum kSum = res != nullptr ? InnerProduct_Dot2_SIMD_Partial( a, b, s, abs_sum ) : InnerProduct_Dot2_SIMD_Partial( a, b, s );
+								return std::make_pair( kSum, abs_sum );
+							};
+
+		return RunTuned( TunedName< T >( "Parallel Dot2" ), kMinSize, kChunkSize, [ & ] ( size_t chunk, size_t threads )
+							{
+								const auto par_sum = ChunkedPartials( v.data(), w.data(), kMinSize, chunk, fun_inter, threads );
+
+								CompensatedSum	theSum;
+								double			abs_sum {};
+								for( const auto & ps : par_sum )
+								{
+									theSum.Add( ps.first );
+									abs_sum += ps.second;
+								}
+
+								const double kValue = theSum.Value();
+
+								if( res != nullptr )
+								{
+									const size_t kLanes = par_sum.size() * kDot2SIMDLanes;
+									abs_sum = AbsSumBound( abs_sum, kMinSize + kLanes );
+									* res = MakeInnerProductResult( kValue, abs_sum, Dot2ErrorBound( kMinSize, kLanes, kValue, abs_sum ) );
+								}
+
+								return kValue;
+							} );
+	}
 
 
-		const double * v_data_begin = & v[ 0 ];
-		const double * w_data_begin = & w[ 0 ];
+	// The chunked double-double - as the Dot2 above, but each chunk
+	// returns a double-double which is renormalized on each step.
+	template < typename T >
+	auto InnerProduct_DoubleDouble_Par( const BasicDataView< T > & v, const BasicDataView< T > & w, const size_t kChunkSize = kAutoTune, InnerProductResult * res = nullptr )
+	{
+		const auto kMinSize { std::min( v.size(), w.size() ) };
 
-		vector< double >	par_sum( k_num_of_chunks + ( k_remainder > 0 ? 1 : 0 ), 0.0 );	
+		auto fun_inter = [ res ] ( const T * a, const T * b, size_t s ) 
+							{ 
+								double abs_sum {};
+								const DoubleDouble kSum = res != nullptr ? InnerProduct_DoubleDouble_SIMD_Partial( a, b, s, abs_sum ) : InnerProduct_DoubleDouble_SIMD_Partial( a, b, s );
+								return std::make_pair( kSum, abs_sum );
+							};
+
+		return RunTuned( TunedName< T >( "Parallel double-double" ), kMinSize, kChunkSize, [ & ] ( size_t chunk, size_t threads )
+							{
+								const auto par_sum = ChunkedPartials( v.data(), w.data(), kMinSize, chunk, fun_inter, threads );
+
+								DoubleDouble	theSum;
+								double			abs_sum {};
+								for( const auto & ps : par_sum )
+								{
+									theSum += ps.first;
+									abs_sum += ps.second;
+								}
+
+								const double kValue = theSum.ToDouble();
+
+								if( res != nullptr )
+								{
+									// The products, and the merges of the lanes and of the chunks
+									const size_t kAdds = kMinSize + par_sum.size() * ( kDoubleDoubleSIMDLanes + 1 );
+									abs_sum = AbsSumBound( abs_sum, kMinSize + par_sum.size() * kDoubleDoubleSIMDLanes );
+									* res = MakeInnerProductResult( kValue, abs_sum, DoubleDoubleErrorBound( kAdds, kValue, abs_sum ) );
+								}
+
+								return kValue;
+							} );
+	}
 
-		// The thing is that we wish Kahan because it is much faster than the sort-accum
-		auto fun_inter = [] ( const double * a, const double * b, int s ) { return InnerProduct_Sort_KahanAlg( a, b, s ); };
 
-		vector< future< double > >		my_thread_poool;
+	// The chunked quad-double - each chunk returns its quad-double,
+	// these are added up in the chunk order. As for the serial one,
+	// there is no rigorous bound, only the condition number.
+	auto InnerProduct_QuadDouble_Par( const DView & v, const DView & w, const size_t kChunkSize = kAutoTune, InnerProductResult * res = nullptr )
+	{
+		const auto kMinSize { std::min( v.size(), w.size() ) };
 
-		// Process all equal size chunks of data
-		std::decay< decltype( k_num_of_chunks ) >::type i {};
-		for( i = 0; i < k_num_of_chunks; ++ i )
-			my_thread_poool.push_back( async( std::launch::async, fun_inter, v_data_begin + i * kChunkSize, w_data_begin + i * kChunkSize, kChunkSize ) );
+		auto fun_inter = [ res ] ( const double * a, const double * b, size_t s ) 
+							{ 
+								double abs_sum {};
+								const QuadDouble kSum = res != nullptr ? InnerProduct_QuadDouble( a, b, s, abs_sum ) : InnerProduct_QuadDouble( a, b, s );
+								return std::make_pair( kSum, abs_sum );
+							};
 
-		// Process the ramainder, if present
-		if( k_remainder > 0 )
-			my_thread_poool.push_back( async( std::launch::async, fun_inter, v_data_begin + i * kChunkSize, w_data_begin + i * kChunkSize, k_remainder ) );
+		return RunTuned( "Parallel quad-double", kMinSize, kChunkSize, [ & ] ( size_t chunk, size_t threads )
+							{
+								const auto par_sum = ChunkedPartials( v.data(), w.data(), kMinSize, chunk, fun_inter, threads );
+
+								QuadDouble		theSum;
+								double			abs_sum {};
+								for( const auto & ps : par_sum )
+								{
+									theSum += ps.first;
+									abs_sum += ps.second;
+								}
+
+								const double kValue = theSum.ToDouble();
 
-		assert( par_sum.size() == my_thread_poool.size() );
-		for( size_t i = 0; i < my_thread_poool.size(); ++ i )
-			par_sum[ i ] = my_thread_poool[ i ].get();
+								if( res != nullptr )
+									* res = MakeInnerProductResult( kValue, AbsSumBound( abs_sum, kMinSize + par_sum.size() ), std::numeric_limits< double >::infinity() );
+
+								return kValue;
+							} );
+	}
 
 
-		return Kahan_Sort_And_Sum( par_sum );		
+	// Each chunk gets its own long accumulator, these are merged exactly,
+	// so the result is the same (correctly rounded) as in the serial version.
+	auto InnerProduct_LongAcc_Par( const DView & v, const DView & w, const size_t kChunkSize = kAutoTune, InnerProductResult * res = nullptr )
+	{
+		const auto kMinSize { std::min( v.size(), w.size() ) };
+
+		auto fun_inter = [ res ] ( const double * a, const double * b, size_t s ) 
+							{ 
+								LongAccumulator		acc;
+								double				abs_sum {};
+								if( res != nullptr )
+									acc.AddProducts( a, b, s, abs_sum );
+								else
+									acc.AddProducts( a, b, s );
+								return std::make_pair( acc, abs_sum );
+							};
+
+		return RunTuned( "Parallel long accumulator", kMinSize, kChunkSize, [ & ] ( size_t chunk, size_t threads )
+							{
+								const auto par_sum = ChunkedPartials( v.data(), w.data(), kMinSize, chunk, fun_inter, threads );
+
+								LongAccumulator		theSum;
+								double				abs_sum {};
+								for( const auto & ps : par_sum )
+								{
+									theSum.Merge( ps.first );
+									abs_sum += ps.second;
+								}
+
+								const double kValue = theSum.GetSum();
+
+								if( res != nullptr )
+									* res = MakeInnerProductResult( kValue, AbsSumBound( abs_sum, kMinSize + par_sum.size() ), UnitRoundoff< double >() * std::fabs( kValue ) );
+
+								return kValue;
+							} );
 	}
 
 
+	namespace PrecLongComp
+	{
+		// The parallel version of InnerProduct_BNum, i.e. the reference of the experiment.
+		// Each chunk goes to its own ExtraBNum and these are added up in the chunk
+		// order. The product of two doubles is exactly h + h_err (TwoProduct), so there
+		// is no big multiplication - only the two doubles are added to the accumulator,
+		// through one ExtraBNum which is reused. But TwoProduct is not exact if h_err
+		// underflows or h overflows (| h | out of [ 2^-968, 2^1000 ), as in
+		// LongAccumulator::AddProduct) - such products are multiplied in ExtraBNum,
+		// as in InnerProduct_BNum, so no product is rounded. The chunks are fixed,
+		// so the result does not depend on the number of threads.
+		// The sum is exact, so the bound in res is that of its rounding to double
+		// (taken to be within one ulp, i.e. 2 u).
+		auto InnerProduct_BNum_Par( const DView & v, const DView & w, InnerProductResult * res = nullptr )
+		{
+			constexpr size_t kChunkSize { size_t( 1 ) << 16 };
+
+			const auto kMinSize { std::min( v.size(), w.size() ) };
+
+			auto fun_inter = [ res ] ( const double * a, const double * b, size_t s ) 
+								{ 
+									ExtraBNum	part = 0;
+
+									ExtraBNum	tmp = 0;
+
+									double		abs_sum {};
+
+									for( size_t i = 0; i < s; ++ i )
+									{
+										double h {}, h_err {};
+										TwoProduct( a[ i ], b[ i ], h, h_err );
+
+										const double kAbsH = std::fabs( h );
+
+										if( res != nullptr )
+											abs_sum += kAbsH;
+
+										if( kAbsH < 0x1p-968 || kAbsH >= 0x1p1000 )
+										{
+											// The exact product, see above
+											if( a[ i ] != 0.0 && b[ i ] != 0.0 )
+											{
+												tmp = a[ i ];
+												tmp *= b[ i ];
+												part.Add( tmp );
+											}
+											continue;
+										}
+
+										tmp = h;
+										part.Add( tmp );
+
+										if( h_err != 0.0 )
+										{
+											tmp = h_err;
+											part.Add( tmp );
+										}
+									}
+
+									return std::make_pair( part, abs_sum );
+								};
+
+			const auto par_sum = ChunkedPartials( v.data(), w.data(), kMinSize, kChunkSize, fun_inter );
+
+			ExtraBNum	theSum = 0;
+			double		abs_sum {};
+			for( const auto & ps : par_sum )
+			{
+				theSum.Add( ps.first );
+				abs_sum += ps.second;
+			}
+
+			if( res != nullptr )
+			{
+				const double kValue = theSum.ToDouble();
+				* res = MakeInnerProductResult( kValue, AbsSumBound( abs_sum, kMinSize + par_sum.size() ), 2.0 * UnitRoundoff< double >() * std::fabs( kValue ) );
+			}
+
+			return theSum;
+		}
+	}
+
 
 
-	auto InnerProduct_908_Par( const DVec & v, const DVec & w, const size_t kChunkSize = 10000 )
+	///////////////////////////////////////////////////////////
+	// The adaptive inner product - as accurate as needed
+	///////////////////////////////////////////////////////////
+	//
+	// INPUT:
+	//		v, w - the input data
+	//		kTolerance - the relative error allowed,
+	//			i.e. | res - exact | <= kTolerance | exact |
+	//		kChunkSize - see ChunkedPartials
+	//		res - if not null, gets the error bound and condition number
+	// OUTPUT:
+	//		the result
+	//
+	// REMARKS:
+	//		All chunks first go through the SIMD Kahan lanes,
+	//		with the sum of | v[ i ] * w[ i ] | in its own lanes
+	//		of the same loop (see InnerProduct_KahanAlg_SIMD_Bounded).
+	//		The partials are added in a LongAccumulator, so the
+	//		only errors are those of the chunks and the final
+	//		rounding. If these are above the tolerance, then
+	//		each chunk whose bound is above its share of it
+	//		(by its length) is computed again with the SIMD Dot2
+	//		and, if still above, exactly - or at once exactly,
+	//		if the bound of Dot2 would be above the share too.
+	//		So only the ill-conditioned parts pay for the
+	//		accuracy; for well-conditioned data, this is a single
+	//		pass at the cost of the parallel SIMD Kahan. The
+	//		tolerance of 0 gives the correctly rounded result.
+	//
+	double InnerProduct_Auto( const DView & v, const DView & w, const double kTolerance, const size_t kChunkSize = kAutoTune, InnerProductResult * res = nullptr )
 	{
 		const auto kMinSize { std::min( v.size(), w.size() ) };
 
-		const size_t k_num_of_chunks { ( kMinSize / kChunkSize ) };
-		const size_t k_remainder { kMinSize % kChunkSize };
+		enum class Tier { kKahan, kDot2, kExact };
 
+		auto fun_inter = [] ( const double * a, const double * b, size_t s ) { return InnerProduct_KahanAlg_SIMD_Bounded( a, b, s ); };
 
-		const double * v_data_begin = & v[ 0 ];
-		const double * w_data_begin = & w[ 0 ];
+		const auto kRes = RunTuned( "Auto", kMinSize, kChunkSize, [ & ] ( size_t chunk, size_t threads )
+							{
+								auto parts = ChunkedPartials( v.data(), w.data(), kMinSize, chunk, fun_inter, threads );
 
-		vector< double >	par_sum( k_num_of_chunks + ( k_remainder > 0 ? 1 : 0 ), 0.0 );
+								vector< Tier >		tier( parts.size(), Tier::kKahan );
 
-		// The lambda for serial summation
-		auto fun_inter = [] ( const double * a, const double * b, int s ) { return ES::InnerProduct_908_par( a, b, s ); };
+								double abs_sum {};
+								for( const auto & p : parts )
+									abs_sum += p.fAbsSum;
+								abs_sum = AbsSumBound( abs_sum, parts.size() );
 
-		vector< future< double > >		my_thread_poool;
+								// The bounds of the chunks are added with the rounding error of at most gamma_m
+								const double kBoundSumFactor { 1.0 + Gamma( parts.size() + 1 ) };
 
-		// Process all equal size chunks of data
-		std::decay< decltype( k_num_of_chunks ) >::type i {};
-		for( i = 0; i < k_num_of_chunks; ++ i )
-			my_thread_poool.push_back( async( std::launch::async, fun_inter, v_data_begin + i * kChunkSize, w_data_begin + i * kChunkSize, kChunkSize ) );
+								auto len_of = [ & ] ( size_t i ) { return std::min( chunk, kMinSize - i * chunk ); };
 
-		// Process the ramainder, if present
-		if( k_remainder > 0 )
-			my_thread_poool.push_back( async( std::launch::async, fun_inter, v_data_begin + k_num_of_chunks * kChunkSize, w_data_begin + k_num_of_chunks * kChunkSize, k_remainder ) );
+								ThreadPool &		pool = GetThreadPool();
+
+								LongAccumulator		exact;		// the sum of the exact chunks
+
+								for( ;; )
+								{
+									LongAccumulator		theSum { exact };
+									double				bound {};
+									for( size_t i = 0; i < parts.size(); ++ i )
+										if( tier[ i ] != Tier::kExact )
+										{
+											theSum.AddNumber( parts[ i ].fValue );
+											bound += parts[ i ].fErrorBound;
+										}
+
+									const double kValue = theSum.GetSum();
+
+									// The chunks and the rounding of their (exact) sum to kValue
+									const double kRounding = UnitRoundoff< double >() * std::fabs( kValue );
+									bound = bound * kBoundSumFactor + kRounding;
+
+									// | exact | >= | kValue | - bound, so this bound gives the relative error of kTolerance;
+									// the chunks share what the rounding leaves of it
+									const double kBudget = kTolerance * std::fabs( kValue ) / ( 1.0 + kTolerance );
+									const double kChunkBudget = std::max( kBudget - kRounding, 0.0 );
+
+									vector< pair< size_t, future< InnerProductResult > > >	to_dot2;
+									vector< future< LongAccumulator > >						to_exact;
 
-		assert( par_sum.size() == my_thread_poool.size() );
-		for( auto i : range(  my_thread_poool.size() ) )
-			par_sum[ i ] = my_thread_poool[ i ].get();
+									if( ! ( bound <= kBudget ) )
+										for( size_t i = 0; i < parts.size(); ++ i )
+										{
+											const size_t kLen { len_of( i ) };
+											const double kShare = kChunkBudget * double( kLen ) / double( kMinSize );
 
-		return ES::Sum_908( par_sum );		
+											if( tier[ i ] == Tier::kExact || parts[ i ].fErrorBound <= kShare )
+												continue;
+
+											const double * a { v.data() + i * chunk };
+											const double * b { w.data() + i * chunk };
+
+											if( tier[ i ] == Tier::kKahan && Dot2ErrorBound( kLen, kDot2SIMDLanes, parts[ i ].fValue, parts[ i ].fAbsSum ) <= kShare )
+											{
+												tier[ i ] = Tier::kDot2;
+												to_dot2.emplace_back( i, pool.Submit( [ = ] () { return InnerProduct_Dot2_SIMD_Bounded( a, b, kLen ); } ) );
+											}
+											else
+											{
+												tier[ i ] = Tier::kExact;
+												to_exact.push_back( pool.Submit( [ = ] ()
+																			{
+																				LongAccumulator		acc;
+																				acc.AddProducts( a, b, kLen );
+																				return acc;
+																			} ) );
+											}
+										}
+
+									// Within the tolerance, or nothing more to do (e.g. inf or NaN in the data)
+									if( to_dot2.empty() && to_exact.empty() )
+										return MakeInnerProductResult( kValue, abs_sum, bound );
+
+									for( auto & [ i, f ] : to_dot2 )
+										parts[ i ] = pool.Get( f );
+
+									for( auto & f : to_exact )
+										exact.Merge( pool.Get( f ) );
+								}
+							} );
+
+		if( res != nullptr )
+			* res = kRes;
+
+		return kRes.fValue;
 	}
 
 
 
 
-	void InnerProduct_Test_3( DVec & v, DVec & w )
+	// Each algorithm is registered here once under its name;
+	// InnerProduct_Test_3 runs all of them, in this order.
+	const bool kInnerProductsRegistered = [] ()
+	{
+		auto & reg = BenchmarkRegistry::Instance();
+
+		constexpr bool kTuned { true };		// the kernel calls RunTuned, so it has a tuning pass
+
+		reg.RegisterGeneric( "Stand",							[] ( const auto & v, const auto & w, size_t, InnerProductResult * r ) { return InnerProduct_StdAlg( v, w, r ); } );
+		reg.RegisterGeneric( "Parallel Transform-Reduce",		[] ( const auto & v, const auto & w, size_t, InnerProductResult * r ) { return InnerProduct_TR_Alg( v, w, r ); } );
+		reg.Register( "Sort",							[] ( const DView & v, const DView & w, size_t, InnerProductResult * r ) { return InnerProduct_SortAlg( v, w, r ); } );
+		reg.RegisterGeneric( "Kahan",							[] ( const auto & v, const auto & w, size_t, InnerProductResult * r ) { return InnerProduct_KahanAlg( v, w, r ); } );
+		reg.RegisterGeneric( "SIMD Kahan",						[] ( const auto & v, const auto & w, size_t, InnerProductResult * r ) { return InnerProduct_KahanAlg_SIMD( v, w, r ); } );
+		reg.Register( "Serial Sort-Kahan",				[] ( const DView & v, const DView & w, size_t, InnerProductResult * r ) { return InnerProduct_Sort_KahanAlg( v, w, r ); } );
+		reg.Register( "Exponent-bucket Kahan",			[] ( const DView & v, const DView & w, size_t, InnerProductResult * r ) { return InnerProduct_ExpBucket_KahanAlg( v, w, r ); } );
+
+		reg.RegisterGeneric( "Parallel Kahan",					[] ( const auto & v, const auto & w, size_t c, InnerProductResult * r ) { return InnerProduct_KahanAlg_Par( v, w, c, r ); } , kTuned );
+		reg.Register( "Parallel Sort-Kahan",			[] ( const DView & v, const DView & w, size_t c, InnerProductResult * r ) { return InnerProduct_SortKahanAlg_Par( v, w, c, r ); } , kTuned );
+		reg.Register( "Parallel 908",					[] ( const DView & v, const DView & w, size_t c, InnerProductResult * r ) { return InnerProduct_908_Par( v, w, c, r ); } , kTuned );
+
+		reg.RegisterGeneric( "Dot2",							[] ( const auto & v, const auto & w, size_t, InnerProductResult * r ) { return InnerProduct_Dot2( v, w, r ); } );
+		reg.RegisterGeneric( "SIMD Dot2",						[] ( const auto & v, const auto & w, size_t, InnerProductResult * r ) { return InnerProduct_Dot2_SIMD( v, w, r ); } );
+		reg.RegisterGeneric( "Parallel Dot2",					[] ( const auto & v, const auto & w, size_t c, InnerProductResult * r ) { return InnerProduct_Dot2_Par( v, w, c, r ); } , kTuned );
+		reg.Register( "Dot3",							[] ( const DView & v, const DView & w, size_t, InnerProductResult * r ) { return InnerProduct_DotK< 3 >( v, w, r ); } );
+		reg.Register( "Dot4",							[] ( const DView & v, const DView & w, size_t, InnerProductResult * r ) { return InnerProduct_DotK< 4 >( v, w, r ); } );
+
+		reg.Register( "Long accumulator",				[] ( const DView & v, const DView & w, size_t, InnerProductResult * r ) { return InnerProduct_LongAcc( v, w, r ); } );
+		reg.Register( "Parallel long accumulator",		[] ( const DView & v, const DView & w, size_t c, InnerProductResult * r ) { return InnerProduct_LongAcc_Par( v, w, c, r ); } , kTuned );
+
+		reg.Register( "Double-double",					[] ( const DView & v, const DView & w, size_t, InnerProductResult * r ) { return InnerProduct_DoubleDouble( v, w, r ); } );
+		reg.RegisterGeneric( "SIMD double-double",				[] ( const auto & v, const auto & w, size_t, InnerProductResult * r ) { return InnerProduct_DoubleDouble_SIMD( v, w, r ); } );
+		reg.RegisterGeneric( "Parallel double-double",			[] ( const auto & v, const auto & w, size_t c, InnerProductResult * r ) { return InnerProduct_DoubleDouble_Par( v, w, c, r ); } , kTuned );
+		reg.Register( "Quad-double",					[] ( const DView & v, const DView & w, size_t, InnerProductResult * r ) { return InnerProduct_QuadDouble( v, w, r ); } );
+		reg.Register( "Parallel quad-double",			[] ( const DView & v, const DView & w, size_t c, InnerProductResult * r ) { return InnerProduct_QuadDouble_Par( v, w, c, r ); } , kTuned );
+
+		// Kahan, then Dot2 or exact only where the tolerance needs it - with the
+		// default of --tolerance, InnerProduct_Test_GeneralExperiment sets the given one
+		reg.Register( "Auto",							[ kTolerance = ExperimentConfig().fTolerance ] ( const DView & v, const DView & w, size_t c, InnerProductResult * r ) { return InnerProduct_Auto( v, w, kTolerance, c, r ); } , kTuned );
+
+		reg.Register( "Serial 908",						[] ( const DView & v, const DView & w, size_t, InnerProductResult * r ) { return ES::InnerProduct_908_b( v, w, r ); } );
+		reg.Register( "Serial fused 908",				[] ( const DView & v, const DView & w, size_t, InnerProductResult * r ) { return ES::InnerProduct_908_c( v, w, r ); } );
+
+		reg.Register( "ttmath",							[] ( const DView & v, const DView & w, size_t, InnerProductResult * r ) { return PrecLongComp::InnerProduct_BNum_Par( v, w, r ).ToDouble(); } );
+
+		// The generic kernels above run on the data set and on the same data rounded
+		// to float (see InnerProduct_Test_GeneralExperiment); this one on the float only
+		reg.RegisterFloat( "Float sum",						[] ( const FView & v, const FView & w, size_t, InnerProductResult * r ) { return InnerProduct_StdAlg< float >( v, w, r ); } );
+
+		return true;
+	} ();
+
+
+
+
+	// True if the registered algorithm is selected in config (all are if none is)
+	// and it takes the data of type T (double or float)
+	template < typename T >
+	bool InnerProduct_Selected( const BenchmarkRegistry::Entry & entry, const ExperimentConfig & config )
+	{
+		const auto & kAlgs = config.fAlgorithms;
+		return entry.Takes< T >() && ( kAlgs.empty() || std::find( kAlgs.begin(), kAlgs.end(), entry.fName ) != kAlgs.end() );
+	}
+
+
+	// Runs the registered algorithms selected in config (all if none) on v and w;
+	// the results go to the console and, as labelled records, to the report files.
+	// The float data is run by the float kernels only, and vice versa.
+	template < typename T >
+	void InnerProduct_Test_3( const BasicDataView< T > & v, const BasicDataView< T > & w, const DatasetInfo & dataset, const ExperimentConfig & config, const BenchmarkReport & report )
 	{
 		assert( v.size() == w.size() );
 
-		// Both dimensions of v and w must be the same
-		// and must be an integer multiplication of the kChunkSize
-		const int kChunkSize { /*10000*/25000/*24000*/ };
-
-
-		// The inner product should be close to 0.0, 
-		// so let us check the two algorithms.
-
-		using timer = typename std::chrono::high_resolution_clock;
-		auto get_duration = [] ( auto prev_time_stamp ) 
-							{ return std::chrono::duration_cast< std::chrono::milliseconds >( 
-													timer::now() - prev_time_stamp ).count(); };
-
-
-		DVec	result_errors;
-		DVec	result_timing;
-
-
-		auto comp_error { 0.0 };
-
-		auto ts = timer::now();
-		comp_error = fabs( InnerProduct_StdAlg( v, w ) );
-		auto tdur = get_duration( ts );
-		cout << "Stand alg error = \t"	<< std::setprecision( 8 ) << comp_error << "\t\tT [ms] = " << tdur << endl;
-		result_errors.push_back( comp_error );
-		result_timing.push_back( tdur );
-
-
-		ts = timer::now();
-		comp_error = fabs( InnerProduct_TR_Alg( v, w ) );
-		tdur = get_duration( ts );
-		cout << "Parallel Transform-Reduce alg error = \t"	<< std::setprecision( 8 ) << comp_error << "\t\tT [ms] = " << tdur << endl;
-		result_errors.push_back( comp_error );
-		result_timing.push_back( tdur );
-		
-		ts = timer::now();
-		comp_error = fabs( InnerProduct_SortAlg( v, w ) );
-		tdur = get_duration( ts );
-		cout << "Sort alg error = \t"	<< std::setprecision( 8 ) << comp_error << "\t\tT [ms] = " << tdur << endl;
-		result_errors.push_back( comp_error );
-		result_timing.push_back( tdur );
-		
-		ts = timer::now();
-		comp_error = fabs( InnerProduct_KahanAlg( v, w ) );
-		tdur = get_duration( ts );
-		cout << "Kahan alg error = \t"	<< std::setprecision( 8 ) << comp_error << "\t\tT [ms] = " << tdur << endl;
-		result_errors.push_back( comp_error );
-		result_timing.push_back( tdur );
-		
-		ts = timer::now();
-		comp_error = fabs( InnerProduct_Sort_KahanAlg( v, w ) );
-		tdur = get_duration( ts );
-		cout << "Serial Sort-Kahan alg error = \t"	<< std::setprecision( 8 ) << comp_error << "\t\tT [ms] = " << tdur << endl;
-		result_errors.push_back( comp_error );
-		result_timing.push_back( tdur );
-		
-	
-		ts = timer::now();
-		comp_error = fabs( InnerProduct_KahanAlg_Par( v, w, kChunkSize ) );
-		tdur = get_duration( ts );
-		cout << "Parallel Kahan alg error = \t"	<< std::setprecision( 8 ) << comp_error << "\t\tT [ms] = " << tdur << endl;
-		result_errors.push_back( comp_error );
-		result_timing.push_back( tdur );
+		auto selected = [ & config ] ( const auto & entry ) { return InnerProduct_Selected< T >( entry, config ); };
+
+		// The tuning pass - the kernels which were not tuned for this data yet
+		// are calibrated now (see AutoTuner::Get), not in the timed runs
+		if( dataset.fChunkSize == kAutoTune )
+		{
+			for( const auto & entry : BenchmarkRegistry::Instance().Entries() )
+				if( entry.fTuned && selected( entry ) )
+					entry.Run( v, w, kAutoTune );
+
+			AutoTuner::Instance().SaveProfile();
+		}
+
+
+		// The errors are relative to the exact inner product
+		cout << "Exact = " << std::setprecision( 17 ) << dataset.fExactValue << ", condition number = " << std::setprecision( 4 ) << dataset.fCondition << endl;
+
+		for( const auto & entry : BenchmarkRegistry::Instance().Entries() )
+		{
+			if( ! selected( entry ) )
+				continue;
+
+			const auto res = RunBenchmark( entry, v, w, dataset.fChunkSize, config.fSettings );
+			const auto & st = res.fStats;
+
+			const auto comp_error = fabs( res.fValue - dataset.fExactValue );
+
+			cout << entry.fName << " alg error = \t" << std::setprecision( 8 ) << comp_error 
+				 << "\t\tT [ns] min = " << std::fixed << std::setprecision( 0 ) << st.fMin_ns << ", median = " << st.fMedian_ns << ", stddev = " << st.fStdDev_ns 
+				 << " (" << st.fRepetitions << " reps)"
+				 << "\t" << std::defaultfloat << std::setprecision( 4 ) << st.fGBps << " GB/s, " << st.fGFLOPs << " GFLOP/s";
+			if( res.fErrorBound >= 0.0 )
+				cout << "\tbound = " << std::setprecision( 4 ) << res.fErrorBound << ", cond = " << res.fCondition;
+
+			// The report has the chunk size and threads the tuned kernel actually ran with
+			DatasetInfo		used { dataset };
+			if( entry.fTuned )
+			{
+				const auto kUsed = AutoTuner::Instance().LastUsed();
+				used.fChunkSize = kUsed.fChunkSize;
+				used.fThreads = kUsed.fThreads;
+				cout << "\tchunk = " << kUsed.fChunkSize << ", threads = " << kUsed.fThreads;
+			}
+			cout << endl;
 
+			report.Write( used, res );
+		}
+
+		cout << "- - -" << endl << endl;
+	}
+
+
+
+	// The matrix kernels on the data set: v is viewed as kRows rows of kCols
+	// elements (both are not multiples of the tiles and lanes, so the remainders
+	// are covered too) and x is the beginning of w. Each y[ r ] of GEMV_KahanAlg_Par
+	// runs the same lanes as InnerProduct_KahanAlg_SIMD of the row, so these must
+	// be equal. Each G[ i, j ] of the Gram matrix of the rows is checked against
+	// InnerProduct_Dot2_SIMD; these differ in the lanes, so each of them is within
+	// the Dot2 bound of the exact value. The 35 rows are 2 full blocks of kGramBlock
+	// and an odd remainder, so there are diagonal, full and edge tiles.
+	void InnerProduct_Test_Matrix( const DView & v, const DView & w, const ExperimentConfig & config )
+	{
+		using timer = std::chrono::steady_clock;
+
+		// The format of cout is set below, and restored at the end
+		const auto kFlags { cout.flags() };
+		const auto kPrecision { cout.precision() };
+
+		constexpr size_t kRows { 35 };
+
+		size_t kCols { std::min( v.size(), w.size() ) / kRows };
+		if( kCols % 2 == 0 && kCols > 0 )
+			-- kCols;		// odd, for the tails of the lanes
+
+		if( kCols == 0 )
+			return;
+
+		const double * A { v.data() };
+		const double * x { w.data() };
+
+		// The best of the repetitions, in ns
+		auto time_of = [ & config ] ( auto fun )
+		{
+			double best { std::numeric_limits< double >::max() };
+			for( size_t r = 0; r < std::max( config.fSettings.fRepetitions, size_t( 1 ) ); ++ r )
+			{
+				const auto ts = timer::now();
+				fun();
+				best = std::min( best, double( std::chrono::duration_cast< std::chrono::nanoseconds >( timer::now() - ts ).count() ) );
+			}
+			return best;
+		};
+
+		const double kU = UnitRoundoff< double >();
+
+		// -----------------------------------------
+		// y = A x against the inner products of the rows
+		vector< double >	y( kRows ), y_row( kRows ), y_serial( kRows );
+
+		const double kRowTime = time_of( [ & ] () { for( size_t r = 0; r < kRows; ++ r ) y_row[ r ] = InnerProduct_KahanAlg_SIMD( A + r * kCols, x, kCols ); } );
+		const double kGemvTime = time_of( [ & ] () { GEMV_KahanAlg( A, 0, kRows, kCols, kCols, x, y_serial.data() ); } );
+		const double kGemvParTime = time_of( [ & ] () { GEMV_KahanAlg_Par( A, kRows, kCols, kCols, x, y.data() ); } );
+
+		const bool kSame = y == y_row && y_serial == y_row;
+
+		cout << "GEMV " << kRows << " x " << kCols << ": y == per-row SIMD Kahan" << ( kSame ? " (OK)" : " (FAILED)" )
+			 << "	T [ns] per-row = " << std::fixed << std::setprecision( 0 ) << kRowTime << ", GEMV = " << kGemvTime << ", parallel GEMV = " << kGemvParTime
+			 << std::defaultfloat << std::setprecision( 3 ) << "	(x" << kRowTime / kGemvTime << " serial)" << endl;
 
-		ts = timer::now();
-		comp_error = fabs( InnerProduct_SortKahanAlg_Par( v, w, kChunkSize ) );
-		tdur = get_duration( ts );
-		cout << "Parallel Sort-Kahan alg error = \t"	<< std::setprecision( 8 ) << comp_error << "\t\tT [ms] = " << tdur << endl;
-		result_errors.push_back( comp_error );
-		result_timing.push_back( tdur );
+		// -----------------------------------------
+		// G = A A^T against the pairwise inner products of the rows
+		vector< double >	G( kRows * kRows ), G_pair( kRows * kRows );
 
-		ts = timer::now();
-		comp_error = fabs( InnerProduct_908_Par( v, w, kChunkSize ) );
-		tdur = get_duration( ts );
-		cout << "Parallel 908 alg error = \t"	<< std::setprecision( 8 ) << comp_error << "\t\tT [ms] = " << tdur << endl;
-		result_errors.push_back( comp_error );
-		result_timing.push_back( tdur );
+		const double kPairTime = time_of( [ & ] ()
+							{
+								for( size_t i = 0; i < kRows; ++ i )
+									for( size_t j = i; j < kRows; ++ j )
+										G_pair[ i * kRows + j ] = InnerProduct_Dot2_SIMD( A + i * kCols, A + j * kCols, kCols );
+							} );
+		const double kGramTime = time_of( [ & ] () { GramMatrix_Dot2_Par( A, kRows, kCols, kCols, G.data() ); } );
 
+		// Both are Dot2 with at most 32 lanes, see Dot2ErrorBound
+		const double kG2 = Gamma( kCols + 2 * 32 );
 
-		// ---------
-		// 908
-		ts = timer::now();
-		comp_error = fabs( ES::InnerProduct_908_b( v, w ) );
-		tdur = get_duration( ts );
-		cout << "Serial 908 alg error = \t"	<< std::setprecision( 8 ) << comp_error << "\t\tT [ms] = " << tdur << endl;
-		result_errors.push_back( comp_error );
-		result_timing.push_back( tdur );
+		double	gram_worst {};
+		bool	symmetric { true };
+		for( size_t i = 0; i < kRows; ++ i )
+			for( size_t j = i; j < kRows; ++ j )
+			{
+				double abs_sum {};
+				for( size_t k = 0; k < kCols; ++ k )
+					abs_sum += std::fabs( A[ i * kCols + k ] * A[ j * kCols + k ] );
+				abs_sum /= 1.0 - Gamma( kCols + 1 );
 
-		// ---------
-		// long precision lib
-		ts = timer::now();
-		comp_error = fabs( PrecLongComp::InnerProduct_BNum( v, w ).ToDouble() );
-		tdur = get_duration( ts );
-		cout << "ttmath alg error = \t"	<< std::setprecision( 8 ) << comp_error << "\t\tT [ms] = " << tdur << endl << "- - -" << endl << endl;
-		result_errors.push_back( comp_error );
-		result_timing.push_back( tdur );
+				const double kRef { G_pair[ i * kRows + j ] };
+				const double kBound = 2.0 * ( 2.0 * kU * std::fabs( kRef ) + kG2 * kG2 * abs_sum ) / ( 1.0 - kU );
+				const double kDiff = std::fabs( G[ i * kRows + j ] - kRef );
 
+				gram_worst = std::max( gram_worst, kDiff == 0.0 ? 0.0 : kDiff / kBound );
+				symmetric = symmetric && G[ i * kRows + j ] == G[ j * kRows + i ];
+			}
 
+		const OrthogonalityReport	kOrtho { CheckOrthogonality( G.data(), kRows ) };
 
+		cout << "Gram " << kRows << " x " << kCols << ": max | G - pairwise SIMD Dot2 | / bound = " << std::setprecision( 3 ) << gram_worst
+			 << ( gram_worst <= 1.0 && symmetric ? " (OK)" : " (FAILED)" ) << ( symmetric ? "" : ", not symmetric" )
+			 << "	T [ns] pairwise = " << std::fixed << std::setprecision( 0 ) << kPairTime << ", Gram = " << kGramTime
+			 << std::defaultfloat << std::setprecision( 3 ) << "	(x" << kPairTime / kGramTime << ")" << endl;
 
+		cout << "Orthogonality of the rows: max cosine = " << kOrtho.fMaxCosine
+			 << ", max | G[ i, j ] | = " << kOrtho.fMaxOffDiag << " at ( " << kOrtho.fMaxRow << ", " << kOrtho.fMaxCol << " ), max | 1 - G[ i, i ] | = " << kOrtho.fMaxDiagDev
+			 << ", || I - G ||_F = " << kOrtho.fFrobenius << ", || I - G ||_inf = " << kOrtho.fMaxRowSum << endl;
 
-		// -----------------------------------------------
-		// Save results
-		ofstream res_file( "inner_results.txt", ios::app );
-		copy( result_errors.begin(), result_errors.end(), ostream_iterator< double >( res_file, "\t" ) );	res_file << endl;
-		copy( result_timing.begin(), result_timing.end(), ostream_iterator< double >( res_file, "\t" ) );	res_file << endl << endl;
-		// -----------------------------------------------
+		cout.flags( kFlags );
+		cout.precision( kPrecision );
 	}
 
 
 
-	// Run the InnerProduct_Test a number of times
-	// with different range of the generated data samples.
-	void InnerProduct_Test_GeneralExperiment( void )
+	// Run the InnerProduct_Test for all combinations of the data sets
+	// and the parallel settings given in config.
+	// The data sets are generated once and cached in config.fCacheDir as vector files
+	// (see VecFile.h); the next runs map them into memory instead.
+	// The all-ones w vectors are not cached, they are filled in again.
+	void InnerProduct_Test_GeneralExperiment( const ExperimentConfig & config )
 	{
+		// For each algorithm each repetition, data set, etc.
+		const BenchmarkReport	theReport( config.fOutput + ".csv", config.fOutput + ".jsonl" );
+
+		const bool kUseCache = ! config.fCacheDir.empty();
+
+		AutoTuner::Instance().SetProfileFile( config.fTuningFile );
 
-		const int kElems = /*100*//*40000000*//*1000000*/20000000/*10000*/;
+		BenchmarkRegistry::Instance().Replace( "Auto", [ kTolerance = config.fTolerance ] ( const DView & v, const DView & w, size_t c, InnerProductResult * r ) { return InnerProduct_Auto( v, w, kTolerance, c, r ); } );
 
-		vector< int >	deltaExpVec { 10, 30, 50, 100, 300, 500/*, 1000, 2000*/ };
+		const NumaTopology		kNumaTopo { GetNumaTopology() };
+
+		std::error_code		ec;
+		if( kUseCache )
+			std::filesystem::create_directories( config.fCacheDir, ec );		// if it fails, the data is just not cached
 
 		DVec	v, w;
 	
-		FP_Test_DataSet_Generator		data_generator;
+		FP_Test_DataSet_Generator		data_generator( config.fSeed );
 
 
 		enum class FP_TestData_Type { kWellConditioned, kRandom, kAnderson, kExactSumIsZero, kMersenneRand_InnerZero };
 
 
-		for( auto dtype : range( (int) FP_TestData_Type::kMersenneRand_InnerZero + 1 ) )
+		for( const auto & type_name : config.fDataTypes )
 		{
+			const int dtype = int( std::find( kDataTypeNames.begin(), kDataTypeNames.end(), type_name ) - kDataTypeNames.begin() );
+			assert( dtype < (int) kDataTypeNames.size() );
+
 			FP_TestData_Type	data_type { dtype };
 
-			for( auto dExp : deltaExpVec )
+			for( auto dExp : config.fExpDeltas )
 			{
-				switch( data_type )
+				for( const size_t kElems : config.fSizes )
 				{
-					// -------------------------------------
-					case FP_TestData_Type::kWellConditioned:
-						cout << "kWellConditioned" << endl;
-						data_generator.Fill_Numerical_Data_No( 1, v, kElems, dExp );
-						w.resize( kElems, 1.0 );	
-						break;
-
-					// ----------------------------
-					case FP_TestData_Type::kRandom:
-						cout << "kRandom" << endl;
-						data_generator.Fill_Numerical_Data_No( 2, v, kElems, dExp );
-						w.resize( kElems, 1.0 );	
-						break;
-					
-					// -----------------------------
-					case FP_TestData_Type::kAnderson:
-						cout << "kAnderson" << endl;
-						data_generator.Fill_Numerical_Data_No( 3, v, kElems, dExp );
-						w.resize( kElems, 1.0 );
-						break;
+					DatasetInfo		dataset;
+					dataset.fType = type_name;
+
+					AutoTuner::Instance().SetDataTag( type_name );		// the tuned chunk of e.g. Auto depends on the data
+
+					VecFileHeader	header;
+					header.fDataType = dtype;
+					header.fExpDelta = dExp;
+					header.fSeed = data_generator.GetSeed();
+					header.fElems = data_type == FP_TestData_Type::kMersenneRand_InnerZero ? kElems / 2 * 2 : kElems;
+
+					const string kFileName = config.fCacheDir + "/" + dataset.fType + "_" + std::to_string( dExp ) + "_" + std::to_string( header.fSeed ) + "_" + std::to_string( kElems );
+
+					// But for kMersenneRand_InnerZero w is all ones - it is not
+					// cached, but filled in again when v is read from the cache
+					const bool kOnesW { data_type != FP_TestData_Type::kMersenneRand_InnerZero };
+
+					MappedVecFile	v_file, w_file;
+					if( kUseCache )
+					{
+						v_file.Open( kFileName + "_v.ipvec" );
+						if( ! kOnesW )
+							w_file.Open( kFileName + "_w.ipvec" );
+					}
+
+					DView	v_view, w_view;
+
+					const bool kMapped = v_file.IsOpen() && v_file.Header().Matches( header ) && ( kOnesW || ( w_file.IsOpen() && w_file.Header().Matches( header ) ) );
+
+					const size_t kN { header.fElems };
+
+					// With --numa the data goes to the pages first touched by the
+					// workers which process it (and nowhere else), see NumaBuffer -
+					// of the pool of the first thread count, pinned before they are
+					// allocated; for the next thread counts the pages are moved
+					NumaBuffer			v_buf, w_buf;
+					bool				numa_placed {};
+					std::vector< int >	placed_nodes;		// the node of each worker the pages are on
+					bool				numa_moved {};
+
+					if( config.fNuma )
+						placed_nodes = PinThreadPool( ResetThreadPool( config.fThreads.empty() ? 0 : config.fThreads.front() ), kNumaTopo );
+
+					if( kMapped )
+					{
+						if( config.fNuma && v_buf.Assign( v_file.View() ) && ( kOnesW ? w_buf.Allocate( kN ) : w_buf.Assign( w_file.View() ) ) )
+						{
+							numa_placed = true;
+							v_file = MappedVecFile();		// not needed anymore
+							w_file = MappedVecFile();
+							if( kOnesW )
+								std::fill( w_buf.data(), w_buf.data() + kN, 1.0 );
+							v_view = v_buf.View();
+							w_view = w_buf.View();
+						}
+						else
+						{
+							// Zero-copy - the kernels run on the mapped files
+							v_view = v_file.View();
+							if( kOnesW )
+							{
+								w.assign( kN, 1.0 );
+								w_view = DView( w );
+							}
+							else
+							{
+								w_view = w_file.View();
+							}
+						}
+					}
+					else
+					{
+						v_file = MappedVecFile();		// unmapped before they are overwritten
+						w_file = MappedVecFile();
+
+						double * v_data {}, * w_data {};
+						if( config.fNuma && v_buf.Allocate( kN ) && w_buf.Allocate( kN ) )
+						{
+							numa_placed = true;
+							v_data = v_buf.data();
+							w_data = w_buf.data();
+						}
+						else
+						{
+							v.resize( kN );
+							w.resize( kN );
+							v_data = v.data();
+							w_data = w.data();
+						}
+
+						switch( data_type )
+						{
+							// -------------------------------------
+							case FP_TestData_Type::kWellConditioned:
+								data_generator.Fill_Numerical_Data_No( 1, v_data, kN, dExp );
+								std::fill( w_data, w_data + kN, 1.0 );
+								break;
+
+							// ----------------------------
+							case FP_TestData_Type::kRandom:
+								data_generator.Fill_Numerical_Data_No( 2, v_data, kN, dExp );
+								std::fill( w_data, w_data + kN, 1.0 );
+								break;
 						
-					// ------------------------------------
-					case FP_TestData_Type::kExactSumIsZero:
-						cout << "kExactSumIsZero" << endl;
-						data_generator.Fill_Numerical_Data_No( 4, v, kElems, dExp );
-						w.resize( kElems, 1.0 );
-						break;
+							// -----------------------------
+							case FP_TestData_Type::kAnderson:
+								data_generator.Fill_Numerical_Data_No( 3, v_data, kN, dExp );
+								std::fill( w_data, w_data + kN, 1.0 );
+								break;
 							
-					// --------------------------------------------
-					case FP_TestData_Type::kMersenneRand_InnerZero:
-						cout << "kMersenneRand_InnerZero" << endl;
-						data_generator.Fill_Numerical_Data_MersenneUniform( v, kElems / 2, pow( 2.0, dExp ) );
-						data_generator.Duplicate( v, + 1.0 );
-						data_generator.Fill_Numerical_Data_MersenneUniform( w, kElems / 2, pow( 2.0, dExp ) );
-						data_generator.Duplicate( w, - 1.0 );
-						break;
-
-					default: assert( false );
-						break;						
-			
-				}
+							// ------------------------------------
+							case FP_TestData_Type::kExactSumIsZero:
+								data_generator.Fill_Numerical_Data_No( 4, v_data, kN, dExp );
+								std::fill( w_data, w_data + kN, 1.0 );
+								break;
+								
+							// --------------------------------------------
+							case FP_TestData_Type::kMersenneRand_InnerZero:
+								data_generator.Fill_Numerical_Data_MersenneUniform( v_data, kN / 2, pow( 2.0, dExp ), 0 );
+								data_generator.Duplicate( v_data, kN / 2, + 1.0 );
+								data_generator.Fill_Numerical_Data_MersenneUniform( w_data, kN / 2, pow( 2.0, dExp ), 1 );
+								data_generator.Duplicate( w_data, kN / 2, - 1.0 );
+								break;
+
+							default: assert( false );
+								break;						
+				
+						}
+
+						if( kUseCache && ( ! WriteVecFile( kFileName + "_v.ipvec", header, v_data ) || ( ! kOnesW && ! WriteVecFile( kFileName + "_w.ipvec", header, w_data ) ) ) )
+							cout << "Cannot cache the data set in " << kFileName << endl;
+
+						v_view = DView( v_data, kN );
+						w_view = DView( w_data, kN );
+					}
 
-				cout << "ExpDelta = " << dExp << "\tVecElems = " << v.size() << endl;
-				InnerProduct_Test_3( v, w );
+					dataset.fExpDelta = dExp;
+					dataset.fSeed = data_generator.GetSeed();
+					dataset.fElems = v_view.size();
+
+					// The reference - the exact (correctly rounded) value
+					// and the condition number of the data set
+					constexpr size_t kRefChunk { size_t( 1 ) << 16 };
+					InnerProductResult	ref;
+					dataset.fExactValue = InnerProduct_LongAcc_Par( v_view, w_view, kRefChunk, & ref );
+					dataset.fCondition = ref.fCondition;
+
+					// The same data rounded to float32, for the float kernels - unless
+					// it does not fit in float. Its own exact value is that of the data
+					// widened back to double (where the products are exact).
+					vector< float >		v_float, w_float;
+					DatasetInfo			float_dataset { dataset };
+					if( std::any_of( BenchmarkRegistry::Instance().Entries().begin(), BenchmarkRegistry::Instance().Entries().end(),
+										[ & config ] ( const auto & entry ) { return InnerProduct_Selected< float >( entry, config ); } ) )
+					{
+						v_float.assign( v_view.begin(), v_view.end() );
+						w_float.assign( w_view.begin(), w_view.end() );
+
+						auto is_finite = [] ( const float x ) { return std::isfinite( x ); };
+						if( std::all_of( v_float.begin(), v_float.end(), is_finite ) && std::all_of( w_float.begin(), w_float.end(), is_finite ) )
+						{
+							const DVec	kVWide( v_float.begin(), v_float.end() ), kWWide( w_float.begin(), w_float.end() );
+
+							float_dataset.fType = dataset.fType + " (float)";
+							float_dataset.fExactValue = InnerProduct_LongAcc_Par( DView( kVWide ), DView( kWWide ), kRefChunk, & ref );
+							float_dataset.fCondition = ref.fCondition;
+						}
+						else
+						{
+							cout << dataset.fType << ", ExpDelta = " << dExp << ": the data does not fit in float, no float kernels are run" << endl;
+							v_float.clear();
+							w_float.clear();
+						}
+					}
+
+					// The same data for each of the parallel settings
+					for( const size_t kThreads : config.fThreads )
+					{
+						ThreadPool & pool = ResetThreadPool( kThreads );
+
+						std::vector< int >	worker_nodes;
+						if( config.fPin || config.fNuma )
+							worker_nodes = PinThreadPool( pool, kNumaTopo );
+
+						// The pages of the buffers move to the nodes of the workers
+						// of this pool (only those not there yet), with no copy
+						if( numa_placed && ! worker_nodes.empty() && worker_nodes != placed_nodes )
+						{
+							if( v_buf.Place( worker_nodes ) & w_buf.Place( worker_nodes ) )		// both are tried
+							{
+								placed_nodes = worker_nodes;
+								numa_moved = true;
+							}
+							else
+							{
+								cout << "Cannot move the pages of the data to the nodes of the workers" << endl;
+							}
+						}
+
+						const char * kPlacement = ! numa_placed ? "" : worker_nodes != placed_nodes ? " (not moved)" : numa_moved ? " (moved)" : " (first touch)";
+
+						for( const size_t kChunkSize : config.fChunkSizes )
+						{
+							dataset.fChunkSize = kChunkSize;
+							dataset.fThreads = pool.size();
+
+							cout << dataset.fType << ( kMapped ? " (mapped)" : "" ) << endl;
+							cout << "ExpDelta = " << dExp << "\tVecElems = " << v_view.size() << "\tChunk = " << ( kChunkSize == kAutoTune ? "auto" : std::to_string( kChunkSize ) ) << "\tThreads = " << dataset.fThreads << endl;
+
+							if( ! worker_nodes.empty() )
+								cout << "NUMA nodes = " << kNumaTopo.Nodes() << "\tremote pages v = " << RemotePageFraction( v_view, worker_nodes ) 
+									 << ", w = " << RemotePageFraction( w_view, worker_nodes ) << kPlacement << endl;
+
+							const NumaStat	kStatBefore { NumaStat::Read() };
+
+							InnerProduct_Test_3( v_view, w_view, dataset, config, theReport );
+
+							if( ! v_float.empty() )
+							{
+								float_dataset.fChunkSize = kChunkSize;
+								float_dataset.fThreads = pool.size();
+
+								cout << float_dataset.fType << endl;
+								InnerProduct_Test_3( FView( v_float ), FView( w_float ), float_dataset, config, theReport );
+							}
+
+							if( config.fPin || config.fNuma )
+							{
+								const NumaStat kStat = NumaStat::Read() - kStatBefore;
+								cout << "NUMA pages allocated: local = " << kStat.fLocal << ", other node = " << kStat.fOther << ", miss = " << kStat.fMiss << endl << endl;
+							}
+						}
+
+						if( config.fMatrix )
+						{
+							InnerProduct_Test_Matrix( v_view, w_view, config );
+							cout << endl;
+						}
+					}
+				}
 			}
 
 		}
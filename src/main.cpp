@@ -15,15 +15,18 @@
 
 #include <iostream>
 #include <string>
+#include <algorithm>
+
+#include "ExperimentConfig.h"
 
 namespace InnerProducts
 {
 	void InnerProduct_Test( double );
-	void InnerProduct_Test_GeneralExperiment( void );
+	void InnerProduct_Test_GeneralExperiment( const ExperimentConfig & config );
 }
 
 
-using std::cout, std::endl, std::cin;
+using std::cout, std::cerr, std::endl, std::cin;
 using std::string;
 
 string	GetCurrentTime( void );
@@ -31,8 +34,40 @@ string	GetCurrentTime( void );
 
 //////////////
 
-int main( void )
+// Run with --help to see the options, with none it runs the experiment of the paper
+int main( int argc, char * argv[] )
 {
+	using namespace InnerProducts;
+
+	ExperimentConfig	config;
+
+	if( ! ParseCommandLine( argc, argv, config, cerr ) )
+	{
+		PrintUsage( cerr, argv[ 0 ] );
+		return 1;
+	}
+
+	if( config.fHelp )
+	{
+		PrintUsage( cout, argv[ 0 ] );
+		return 0;
+	}
+
+	const auto & kEntries = BenchmarkRegistry::Instance().Entries();
+
+	if( config.fListAlgorithms )
+	{
+		for( const auto & entry : kEntries )
+			cout << entry.fName << endl;
+		return 0;
+	}
+
+	for( const auto & alg : config.fAlgorithms )
+		if( std::none_of( kEntries.begin(), kEntries.end(), [ & alg ] ( const auto & entry ) { return entry.fName == alg; } ) )
+		{
+			cerr << "Unknown algorithm " << alg << " (see --list)" << endl;
+			return 1;
+		}
 
 	cout << "===========================" << endl;
 	cout << "Inner Product Test - let's begin!" << endl;
@@ -40,7 +75,7 @@ int main( void )
 	cout << "===========================" << endl << endl;
 
 
-	InnerProducts::InnerProduct_Test_GeneralExperiment();
+	InnerProduct_Test_GeneralExperiment( config );
 
 }
 